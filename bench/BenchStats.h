@@ -0,0 +1,16 @@
+#ifndef BENCHSTATS_H
+#define BENCHSTATS_H
+
+#include <QVector>
+#include <algorithm>
+#include <cmath>
+
+// Nearest-rank percentile, p in 0..1. 0 for no samples.
+inline double percentile(QVector<double> values, double p) {
+    if (values.isEmpty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    int rank = qBound(0, (int)std::ceil(p * values.size()) - 1, values.size() - 1);
+    return values[rank];
+}
+
+#endif // BENCHSTATS_H
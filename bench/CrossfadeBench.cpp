@@ -0,0 +1,91 @@
+// Crossfade kernel microbenchmark: checks every available kernel against the
+// scalar one, then times full-frame blends and reports frames per second.
+//
+//   crossfade_bench [width height [frames]]   (default 1920 1080 300)
+
+#include "Crossfade.h"
+#include <QElapsedTimer>
+#include <QVector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+struct Candidate {
+    const char* name;
+    Crossfade::Kernel kernel;
+};
+
+quint32 nextRandom(quint32& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+}
+
+int main(int argc, char** argv) {
+    int width = argc > 2 ? atoi(argv[1]) : 1920;
+    int height = argc > 2 ? atoi(argv[2]) : 1080;
+    int frames = argc > 3 ? atoi(argv[3]) : 300;
+    if (width <= 0 || height <= 0 || frames <= 0) {
+        fprintf(stderr, "usage: %s [width height [frames]]\n", argv[0]);
+        return 2;
+    }
+
+    int count = width * height;
+    QVector<quint32> from(count), to(count), out(count), expected(count);
+    quint32 state = 0x2545f491;
+    for (int i = 0; i < count; ++i) {
+        // Premultiplied: colour channels never exceed alpha
+        quint32 a = nextRandom(state) & 0xff;
+        quint32 c = nextRandom(state);
+        from[i] = (a << 24) | (((c & 0xff) * a / 255) << 16) | ((((c >> 8) & 0xff) * a / 255) << 8) |
+                  (((c >> 16) & 0xff) * a / 255);
+        to[i] = nextRandom(state) | 0xff000000;
+    }
+
+    Candidate candidates[] = {
+        {"scalar", Crossfade::scalarKernel()},
+        {"sse2", Crossfade::sse2Kernel()},
+        {"avx2", Crossfade::avx2Kernel()},
+        {"neon", Crossfade::neonKernel()},
+    };
+
+    printf("%dx%d, %d frames, dispatch picks %s\n", width, height, frames, Crossfade::kernelName());
+
+    int failures = 0;
+    for (const Candidate& c : candidates) {
+        if (!c.kernel) {
+            printf("  %-7s not available\n", c.name);
+            continue;
+        }
+
+        // Odd lengths and both ends of the alpha range exercise the tails
+        const int alphas[] = {0, 1, 127, 128, 255, 256};
+        bool ok = true;
+        for (int alpha : alphas) {
+            int n = count - 3;
+            Crossfade::scalarKernel()(from.constData(), to.constData(), expected.data(), n, alpha);
+            c.kernel(from.constData(), to.constData(), out.data(), n, alpha);
+            if (memcmp(out.constData(), expected.constData(), n * sizeof(quint32)) != 0) ok = false;
+        }
+        if (!ok) {
+            printf("  %-7s MISMATCH against scalar\n", c.name);
+            failures++;
+            continue;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        for (int f = 0; f < frames; ++f) {
+            c.kernel(from.constData(), to.constData(), out.data(), count, (f * 256) / frames);
+        }
+        qint64 ns = timer.nsecsElapsed();
+        double msPerFrame = ns / 1e6 / frames;
+        double gbPerSec = (3.0 * count * sizeof(quint32) * frames) / ns;
+        printf("  %-7s %8.3f ms/frame  %8.1f fps  %6.2f GB/s\n", c.name, msPerFrame, 1000.0 / msPerFrame, gbPerSec);
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,235 @@
+// Offscreen transition benchmark. Drives a real SlideshowWidget through
+// crossfades at 720p, 1080p and 4K and times every paintEvent, so a
+// rendering change gets numbers without a display (or a Pi) attached.
+//
+// The slides are synthetic and deliberately mixed: JPEG, PNG with and
+// without alpha, and BMP, at landscape, portrait, panorama and square
+// aspect ratios, so fades cross letterbox shapes and source formats.
+// Slides are on screen long enough for the prefetch ring to have the next
+// one decoded, so fades run between pre-decoded frames.
+//
+//   render_bench [--fades N] [--ken-burns] [--sizes WxH,...] [--output FILE]
+//
+// Prints a table to stderr and JSON to stdout (or --output).
+
+#include "BenchStats.h"
+#include "ConfigManager.h"
+#include "Crossfade.h"
+#include "SlideshowWidget.h"
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QImageWriter>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPainter>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+const double kSlideSeconds = 2.0;
+const double kTransitionSeconds = 1.0;
+
+struct SlideSpec {
+    int width;
+    int height;
+    const char* format;
+    bool alpha;
+};
+
+const SlideSpec kSlides[] = {
+    {4000, 3000, "jpg", false}, // 4:3 camera
+    {2000, 3000, "png", false}, // Portrait
+    {6000, 2000, "jpg", false}, // Panorama
+    {2048, 2048, "png", true},  // Square, with alpha
+    {1600, 1200, "bmp", false},
+    {3000, 4000, "jpg", false}, // Portrait camera
+};
+
+QStringList writeSlides(const QString& dir) {
+    QStringList paths;
+    int i = 0;
+    for (const SlideSpec& spec : kSlides) {
+        QImage image(spec.width, spec.height, spec.alpha ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+        QPainter p(&image);
+        QLinearGradient gradient(0, 0, spec.width, spec.height);
+        gradient.setColorAt(0, QColor::fromHsv(i * 60 % 360, 200, 230, spec.alpha ? 160 : 255));
+        gradient.setColorAt(1, QColor::fromHsv((i * 60 + 150) % 360, 180, 90));
+        p.fillRect(image.rect(), gradient);
+        p.setPen(QPen(Qt::white, spec.width / 200));
+        for (int x = 0; x < spec.width; x += spec.width / 16) p.drawLine(x, 0, spec.width - x, spec.height);
+        p.end();
+
+        QString path = QDir(dir).filePath(QString("slide%1_%2x%3.%4").arg(i).arg(spec.width)
+                                              .arg(spec.height).arg(spec.format));
+        QImageWriter writer(path, spec.format);
+        if (!writer.write(image)) {
+            fprintf(stderr, "can't write %s: %s\n", qPrintable(path), qPrintable(writer.errorString()));
+            return QStringList();
+        }
+        paths << path;
+        i++;
+    }
+    return paths;
+}
+
+// Times the real paintEvent and splits frames into fades
+class TimedSlideshow : public SlideshowWidget {
+public:
+    QVector<double> fadePaintMs;   // Paints while a fade was running
+    QVector<double> staticPaintMs; // Everything else (first frame, fade ends, Ken Burns between fades)
+    QVector<double> fadeFps;
+    double fadeSeconds = 0;
+    int fades = 0;
+
+protected:
+    void paintEvent(QPaintEvent* event) override {
+        bool fading = isTransitioning();
+        QElapsedTimer timer;
+        timer.start();
+        SlideshowWidget::paintEvent(event);
+        double ms = timer.nsecsElapsed() / 1e6;
+
+        if (!m_wall.isValid()) m_wall.start();
+        qint64 now = m_wall.nsecsElapsed();
+        if (fading && !m_inFade) {
+            m_inFade = true;
+            m_fadeStart = now;
+            m_fadeFrames = 0;
+        } else if (!fading && m_inFade) {
+            m_inFade = false;
+            double seconds = (now - m_fadeStart) / 1e9;
+            if (seconds > 0) fadeFps << m_fadeFrames / seconds;
+            fadeSeconds += seconds;
+            fades++;
+        }
+        if (fading) {
+            fadePaintMs << ms;
+            m_fadeFrames++;
+        } else {
+            staticPaintMs << ms;
+        }
+    }
+
+private:
+    QElapsedTimer m_wall;
+    bool m_inFade = false;
+    qint64 m_fadeStart = 0;
+    int m_fadeFrames = 0;
+};
+
+QJsonObject runAt(const QStringList& paths, const QSize& size, int fades, bool kenBurns) {
+    TimedSlideshow widget;
+    widget.resize(size);
+    widget.show();
+
+    widget.setImagePaths(paths);
+    widget.startSlideshow(0);
+
+    // Fade count, or a generous deadline if frames are so slow fades stall
+    QEventLoop loop;
+    QTimer poll;
+    QObject::connect(&poll, &QTimer::timeout, &loop, [&] { if (widget.fades >= fades) loop.quit(); });
+    poll.start(50);
+    QTimer::singleShot((int)((kSlideSeconds + kTransitionSeconds) * 1000 * (fades + 2) * 4), &loop, &QEventLoop::quit);
+    loop.exec();
+    widget.stopSlideshow();
+
+    double frames = widget.fadePaintMs.size();
+    double fps = widget.fadeSeconds > 0 ? frames / widget.fadeSeconds : 0.0;
+    QString name = QString("%1@%2x%3").arg(kenBurns ? "kenburns" : "fade").arg(size.width()).arg(size.height());
+    QJsonObject obj;
+    obj["name"] = name;
+    obj["fades"] = widget.fades;
+    obj["frames"] = (int)frames;
+    obj["seconds"] = widget.fadeSeconds;
+    obj["fps"] = fps;
+    obj["worst_fade_fps"] = widget.fadeFps.isEmpty() ? 0.0 : *std::min_element(widget.fadeFps.begin(), widget.fadeFps.end());
+    obj["paint_p50_ms"] = percentile(widget.fadePaintMs, 0.50);
+    obj["paint_p99_ms"] = percentile(widget.fadePaintMs, 0.99);
+    obj["paint_max_ms"] = percentile(widget.fadePaintMs, 1.0);
+    obj["static_paint_p50_ms"] = percentile(widget.staticPaintMs, 0.50);
+    obj["late_frames"] = widget.lateFrames();
+    obj["dropped_frames"] = widget.droppedFrames();
+    fprintf(stderr, "%-20s %3d fades %5d frames %6.1f fps (worst %5.1f)  paint p50 %7.3f p99 %7.3f max %7.3f ms"
+                    "  late %d dropped %d\n",
+            qPrintable(name), widget.fades, (int)frames, fps, obj["worst_fade_fps"].toDouble(),
+            obj["paint_p50_ms"].toDouble(), obj["paint_p99_ms"].toDouble(), obj["paint_max_ms"].toDouble(),
+            widget.lateFrames(), widget.droppedFrames());
+    if (widget.fades < fades) fprintf(stderr, "%s: only %d of %d fades finished\n", qPrintable(name), widget.fades, fades);
+    return obj;
+}
+}
+
+int main(int argc, char** argv) {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+    QCoreApplication::setOrganizationName("Antigravity");
+    QCoreApplication::setApplicationName("SmoothSlideshowBench");
+    QStandardPaths::setTestModeEnabled(true); // Never the user's config
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Offscreen SlideshowWidget transition benchmark; prints JSON results");
+    parser.addHelpOption();
+    QCommandLineOption fadesOption("fades", "Fades per resolution (default 6).", "N", "6");
+    QCommandLineOption sizesOption("sizes", "Widget sizes (default 1280x720,1920x1080,3840x2160).", "WxH,...",
+                                   "1280x720,1920x1080,3840x2160");
+    QCommandLineOption kenBurnsOption("ken-burns", "Pan/zoom mode instead of static slides.");
+    QCommandLineOption outputOption("output", "Write the JSON here instead of stdout.", "FILE");
+    parser.addOptions({fadesOption, sizesOption, kenBurnsOption, outputOption});
+    parser.process(app);
+
+    int fades = parser.value(fadesOption).toInt();
+    QVector<QSize> sizes;
+    for (const QString& text : parser.value(sizesOption).split(',')) {
+        if (text.isEmpty()) continue;
+        QStringList parts = text.toLower().split('x');
+        QSize size = parts.size() == 2 ? QSize(parts[0].toInt(), parts[1].toInt()) : QSize();
+        if (size.isEmpty()) parser.showHelp(2);
+        sizes << size;
+    }
+    if (fades <= 0 || sizes.isEmpty()) parser.showHelp(2);
+
+    QTemporaryDir scratch;
+    QStringList paths = scratch.isValid() ? writeSlides(scratch.path()) : QStringList();
+    if (paths.isEmpty()) return 1;
+
+    bool kenBurns = parser.isSet(kenBurnsOption);
+    ConfigManager& config = ConfigManager::instance();
+    config.setSlideDuration(kSlideSeconds);
+    config.setTransitionTime(kTransitionSeconds);
+    config.setContinuousLoop(true);
+    config.setRandomOrder(false);
+    config.setKenBurns(kenBurns);
+
+    QJsonArray results;
+    for (const QSize& size : sizes) results << runAt(paths, size, fades, kenBurns);
+
+    QJsonObject root;
+    root["kernel"] = QString(Crossfade::kernelName());
+    root["mode"] = kenBurns ? "kenburns" : "fade";
+    root["slide_seconds"] = kSlideSeconds;
+    root["transition_seconds"] = kTransitionSeconds;
+    root["platform"] = QGuiApplication::platformName();
+    root["qt"] = QString(qVersion());
+    root["results"] = results;
+
+    QByteArray json = QJsonDocument(root).toJson();
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+            fprintf(stderr, "can't write %s\n", qPrintable(parser.value(outputOption)));
+            return 1;
+        }
+    } else {
+        fwrite(json.constData(), 1, json.size(), stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,321 @@
+// Headless loader pipeline benchmark. Generates a synthetic corpus, then
+// times the real loaders on it and prints one JSON document, meant to be
+// saved per commit and diffed:
+//
+//   thumbnails.cold   ThumbnailLoader on an empty cache (decode + store)
+//   thumbnails.warm   A fresh ThumbnailLoader on the cache just filled
+//   slides.decode     ImageCacheLoader at screen size, slide cache off
+//   metadata.*        MetadataJournal checkpoint/load/put at 10k and 100k
+//
+// Latencies are per item: time to icon for thumbnails (from setPaths), the
+// loader's own decode time for slides, per call for metadata.
+//
+// Runs with QStandardPaths test mode on, so the real thumbnail cache and
+// config are never touched. Needs no display (offscreen platform).
+//
+//   slideshow_bench [--count N] [--size WxH] [--format jpg|png] [--screen WxH]
+//                   [--corpus DIR] [--output FILE]
+
+#include "BenchStats.h"
+#include "ConfigManager.h"
+#include "ImageCacheLoader.h"
+#include "MetadataJournal.h"
+#include "ThumbnailLoader.h"
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QGuiApplication>
+#include <QImageWriter>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QTimer>
+#include <cstdio>
+#include <functional>
+
+namespace {
+const int kTimeoutMs = 30 * 60 * 1000; // Per phase; a hung loader fails the run
+const int kMetadataRepeats = 5;
+const int kMetadataPuts = 10000;
+
+QSize parseSize(const QString& text) {
+    QStringList parts = text.toLower().split('x');
+    if (parts.size() != 2) return QSize();
+    return QSize(parts[0].toInt(), parts[1].toInt());
+}
+
+QJsonObject result(const QString& name, int items, double seconds, const QVector<double>& latenciesMs) {
+    QJsonObject obj;
+    obj["name"] = name;
+    obj["items"] = items;
+    obj["seconds"] = seconds;
+    obj["per_second"] = seconds > 0 ? items / seconds : 0.0;
+    obj["p50_ms"] = percentile(latenciesMs, 0.50);
+    obj["p99_ms"] = percentile(latenciesMs, 0.99);
+    fprintf(stderr, "%-28s %7d items %9.3f s %10.1f/s  p50 %8.3f ms  p99 %8.3f ms\n",
+            qPrintable(name), items, seconds, obj["per_second"].toDouble(),
+            obj["p50_ms"].toDouble(), obj["p99_ms"].toDouble());
+    return obj;
+}
+
+// Smooth gradients plus a little noise: compresses like a photo, not like
+// a flat fill or pure noise
+QImage syntheticImage(const QSize& size, quint32 seed) {
+    QImage image(size, QImage::Format_RGB32);
+    quint32 state = seed * 2654435761u + 1;
+    for (int y = 0; y < size.height(); ++y) {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < size.width(); ++x) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            int noise = (int)(state & 15) - 8;
+            int r = (x * 255 / size.width() + seed * 37) & 255;
+            int g = (y * 255 / size.height() + seed * 91) & 255;
+            int b = ((x + y) * 255 / (size.width() + size.height()) + seed * 13) & 255;
+            line[x] = qRgb(qBound(0, r + noise, 255), qBound(0, g + noise, 255), qBound(0, b + noise, 255));
+        }
+    }
+    return image;
+}
+
+// Reuses files already there, so a corpus can be generated once and kept
+QStringList generateCorpus(const QString& dir, int count, const QSize& size, const QString& format) {
+    QDir().mkpath(dir);
+    QStringList paths;
+    QElapsedTimer timer;
+    timer.start();
+    int written = 0;
+    for (int i = 0; i < count; ++i) {
+        QString path = QDir(dir).filePath(QString("img_%1x%2_%3.%4").arg(size.width()).arg(size.height())
+                                              .arg(i, 6, 10, QChar('0')).arg(format));
+        if (!QFile::exists(path)) {
+            QImageWriter writer(path, format.toLatin1());
+            writer.setQuality(90);
+            if (!writer.write(syntheticImage(size, i))) {
+                fprintf(stderr, "can't write %s: %s\n", qPrintable(path), qPrintable(writer.errorString()));
+                return QStringList();
+            }
+            written++;
+        }
+        paths << path;
+    }
+    fprintf(stderr, "corpus: %d images in %s (%d generated in %.1f s)\n",
+            count, qPrintable(dir), written, timer.elapsed() / 1000.0);
+    return paths;
+}
+
+// Runs loop until done() says so or the phase times out
+bool runUntil(QEventLoop& loop, const std::function<bool()>& done) {
+    if (done()) return true;
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    QObject::connect(&timeout, &QTimer::timeout, &loop, &QEventLoop::quit);
+    timeout.start(kTimeoutMs);
+    loop.exec();
+    return done();
+}
+
+QJsonObject benchThumbnails(const QString& name, const QStringList& paths) {
+    QThread thread;
+    thread.setObjectName("thumbnails");
+    ThumbnailLoader* loader = new ThumbnailLoader();
+    loader->moveToThread(&thread);
+    QObject::connect(&thread, &QThread::started, loader, &ThumbnailLoader::process);
+
+    QEventLoop loop;
+    QElapsedTimer timer;
+    QVector<double> latencies;
+    QVector<bool> seen(paths.size(), false);
+    QObject::connect(loader, &ThumbnailLoader::thumbnailsReady, &loop, [&](QVector<ThumbnailResult> results) {
+        double now = timer.nsecsElapsed() / 1e6;
+        for (const ThumbnailResult& r : results) {
+            if (r.index < 0 || r.index >= seen.size() || seen[r.index]) continue;
+            seen[r.index] = true;
+            latencies << now;
+        }
+        if (latencies.size() == paths.size()) loop.quit();
+    });
+
+    // Everything visible, so every thumbnail is delivered as an icon
+    loader->setIconSize(QSize(150, 150), 1.0);
+    loader->setVisibleRange(0, paths.size() - 1);
+    thread.start();
+    timer.start();
+    loader->setPaths(paths);
+    bool ok = runUntil(loop, [&] { return latencies.size() == paths.size(); });
+    double seconds = timer.nsecsElapsed() / 1e9;
+
+    loader->stop();
+    thread.quit();
+    thread.wait();
+    delete loader;
+    if (!ok) fprintf(stderr, "%s: timed out with %d/%d icons\n", qPrintable(name), latencies.size(), paths.size());
+    return result(name, latencies.size(), seconds, latencies);
+}
+
+QJsonObject benchSlides(const QStringList& paths, const QSize& screen) {
+    ImageCacheLoader loader;
+    loader.setCacheMaxSizeMB(0); // Every request decodes
+
+    QEventLoop loop;
+    QVector<double> latencies;
+    int delivered = 0;
+    QObject::connect(&loader, &ImageCacheLoader::imageLoaded, &loop,
+                     [&](quint64, QString, SlideFrame, int decodeMs) {
+        delivered++;
+        if (decodeMs >= 0) latencies << decodeMs;
+        if (delivered == paths.size()) loop.quit();
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    for (const QString& path : paths) loader.requestImage(path, screen);
+    bool ok = runUntil(loop, [&] { return delivered == paths.size(); });
+    double seconds = timer.nsecsElapsed() / 1e9;
+    // Unreadable files are never delivered; they'd only show up as a timeout
+    if (!ok) fprintf(stderr, "slides.decode: timed out with %d/%d slides\n", delivered, paths.size());
+    return result(QString("slides.decode@%1x%2").arg(screen.width()).arg(screen.height()),
+                  delivered, seconds, latencies);
+}
+
+QJsonArray benchMetadata(const QString& root, int entries) {
+    QMap<QString, CacheMetadata> metadata;
+    for (int i = 0; i < entries; ++i) {
+        CacheMetadata meta;
+        meta.lastModified = 1600000000000LL + i;
+        meta.fileSize = 3 * 1024 * 1024 + i;
+        meta.sizeBytes = 40 * 1024;
+        meta.lastAccess = 1700000000000LL + i;
+        meta.cacheKey = QString("%1").arg(quint64(i) * 0x9E3779B97F4A7C15ULL, 16, 16, QChar('0'));
+        meta.previewEdge = 0;
+        metadata.insert(QString("/photos/%1/%2/IMG_%3.jpg").arg(i / 10000).arg(i / 100 % 100).arg(i, 6, 10, QChar('0')),
+                        meta);
+    }
+
+    QString dir = QDir(root).filePath(QString("metadata-%1").arg(entries));
+    QDir(dir).removeRecursively();
+    QDir().mkpath(dir);
+
+    QVector<double> saveMs, loadMs, putMs;
+    double saveTotal = 0, loadTotal = 0, putTotal = 0;
+    QElapsedTimer timer;
+    for (int run = 0; run < kMetadataRepeats; ++run) {
+        MetadataJournal journal(dir);
+        timer.start();
+        journal.checkpoint(metadata);
+        saveMs << timer.nsecsElapsed() / 1e6;
+        saveTotal += saveMs.last() / 1000.0;
+
+        // Appends on top of the snapshot, as the loader does between checkpoints
+        auto it = metadata.constBegin();
+        QElapsedTimer putTimer;
+        for (int i = 0; i < kMetadataPuts && it != metadata.constEnd(); ++i, ++it) {
+            putTimer.start();
+            journal.recordPut(it.key(), it.value());
+            putMs << putTimer.nsecsElapsed() / 1e6;
+            putTotal += putMs.last() / 1000.0;
+        }
+    }
+    for (int run = 0; run < kMetadataRepeats; ++run) {
+        MetadataJournal journal(dir);
+        QMap<QString, CacheMetadata> loaded;
+        timer.start();
+        journal.load(loaded);
+        loadMs << timer.nsecsElapsed() / 1e6;
+        loadTotal += loadMs.last() / 1000.0;
+        if (loaded.size() != metadata.size()) {
+            fprintf(stderr, "metadata: loaded %d of %d entries\n", loaded.size(), metadata.size());
+        }
+    }
+    QDir(dir).removeRecursively();
+
+    // items are entries moved, so per_second compares across sizes
+    QString suffix = entries >= 1000 ? QString("%1k").arg(entries / 1000) : QString::number(entries);
+    QJsonArray out;
+    out << result("metadata.checkpoint@" + suffix, entries * kMetadataRepeats, saveTotal, saveMs);
+    out << result("metadata.load@" + suffix, entries * kMetadataRepeats, loadTotal, loadMs);
+    out << result("metadata.put@" + suffix, putMs.size(), putTotal, putMs);
+    return out;
+}
+}
+
+int main(int argc, char** argv) {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+    QCoreApplication::setOrganizationName("Antigravity");
+    QCoreApplication::setApplicationName("SmoothSlideshowBench");
+    // Cache and config go to the test locations, never the user's
+    QStandardPaths::setTestModeEnabled(true);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Loader pipeline benchmark; prints JSON results");
+    parser.addHelpOption();
+    QCommandLineOption countOption("count", "Images in the corpus (default 200).", "N", "200");
+    QCommandLineOption sizeOption("size", "Corpus image size (default 4000x3000).", "WxH", "4000x3000");
+    QCommandLineOption formatOption("format", "Corpus format, jpg or png (default jpg).", "format", "jpg");
+    QCommandLineOption screenOption("screen", "Slide size for the decode run (default 1920x1080).", "WxH", "1920x1080");
+    QCommandLineOption corpusOption("corpus", "Keep the corpus in DIR and reuse it across runs.", "DIR");
+    QCommandLineOption outputOption("output", "Write the JSON here instead of stdout.", "FILE");
+    parser.addOptions({countOption, sizeOption, formatOption, screenOption, corpusOption, outputOption});
+    parser.process(app);
+
+    int count = parser.value(countOption).toInt();
+    QSize size = parseSize(parser.value(sizeOption));
+    QSize screen = parseSize(parser.value(screenOption));
+    QString format = parser.value(formatOption).toLower();
+    if (count <= 0 || size.isEmpty() || screen.isEmpty() || (format != "jpg" && format != "png")) {
+        parser.showHelp(2);
+    }
+
+    QTemporaryDir scratch;
+    if (!scratch.isValid()) {
+        fprintf(stderr, "can't create a scratch directory\n");
+        return 1;
+    }
+    QString corpusDir = parser.isSet(corpusOption) ? parser.value(corpusOption) : scratch.filePath("corpus");
+    QStringList paths = generateCorpus(corpusDir, count, size, format);
+    if (paths.isEmpty()) return 1;
+
+    // Start from an empty thumbnail cache, and don't let it evict mid-run
+    QString configDir = QStandardPaths::writableLocation(QStandardPaths::ConfigLocation);
+    QDir(configDir + "/Endless_Slides/thumbnails").removeRecursively();
+    ConfigManager::instance().setCacheMaxSizeMB(1024 * 1024);
+
+    QJsonArray results;
+    results << benchThumbnails("thumbnails.cold", paths);
+    results << benchThumbnails("thumbnails.warm", paths);
+    results << benchSlides(paths, screen);
+    for (const QJsonValue& v : benchMetadata(scratch.path(), 10000)) results << v;
+    for (const QJsonValue& v : benchMetadata(scratch.path(), 100000)) results << v;
+    QDir(configDir + "/Endless_Slides/thumbnails").removeRecursively();
+
+    QJsonObject corpus;
+    corpus["count"] = count;
+    corpus["width"] = size.width();
+    corpus["height"] = size.height();
+    corpus["format"] = format;
+    QJsonObject root;
+    root["corpus"] = corpus;
+    root["screen"] = QString("%1x%2").arg(screen.width()).arg(screen.height());
+    root["threads"] = QThread::idealThreadCount();
+    root["qt"] = QString(qVersion());
+    root["results"] = results;
+
+    QByteArray json = QJsonDocument(root).toJson();
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+            fprintf(stderr, "can't write %s\n", qPrintable(parser.value(outputOption)));
+            return 1;
+        }
+    } else {
+        fwrite(json.constData(), 1, json.size(), stdout);
+    }
+    return 0;
+}
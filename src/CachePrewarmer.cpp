@@ -0,0 +1,166 @@
+#include "CachePrewarmer.h"
+#include "ConfigManager.h"
+#include <QDir>
+#include <QTimer>
+#include <cstdio>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+namespace {
+// Log lines when stderr isn't a terminal (cron, provisioning logs)
+const int kLogIntervalMs = 5000;
+const double kMB = 1024.0 * 1024.0;
+
+QString duration(qint64 seconds) {
+    if (seconds >= 3600) {
+        return QString("%1:%2:%3").arg(seconds / 3600).arg(seconds / 60 % 60, 2, 10, QChar('0'))
+                                  .arg(seconds % 60, 2, 10, QChar('0'));
+    }
+    return QString("%1:%2").arg(seconds / 60).arg(seconds % 60, 2, 10, QChar('0'));
+}
+}
+
+CachePrewarmer::CachePrewarmer(QObject* parent)
+    : QObject(parent), m_scanner(new DirectoryScanner(this)), m_loader(nullptr), m_maxBytes(0),
+      m_found(0), m_lastIdlePaths(-1), m_scanDone(false), m_finished(false), m_interactive(false), m_last()
+{
+#ifdef Q_OS_UNIX
+    m_interactive = isatty(fileno(stderr));
+#endif
+    m_thread.setObjectName("thumbnails");
+    connect(m_scanner, &DirectoryScanner::filesFound, this, &CachePrewarmer::onFilesFound);
+    connect(m_scanner, &DirectoryScanner::finished, this, &CachePrewarmer::onScanFinished);
+}
+
+CachePrewarmer::~CachePrewarmer() {
+    m_scanner->cancel();
+    if (m_loader) {
+        m_loader->stop();
+        m_thread.quit();
+        m_thread.wait();
+        delete m_loader;
+    }
+}
+
+void CachePrewarmer::start(const QString& folder, bool recursive, int jobs) {
+    if (!QDir(folder).exists()) {
+        fprintf(stderr, "Pre-warm: no such folder: %s\n", qPrintable(folder));
+        QTimer::singleShot(0, this, [this]() { finish(Failed); });
+        return;
+    }
+
+    m_maxBytes = (qint64)(ConfigManager::instance().cacheMaxSizeMB() * kMB);
+    if (jobs <= 0) jobs = QThread::idealThreadCount();
+
+    // Nothing visible, so nothing is composed or delivered: generate only
+    m_loader = new ThumbnailLoader();
+    m_loader->setWorkerCount(jobs);
+    m_loader->setFillCache(true);
+    m_loader->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::started, m_loader, &ThumbnailLoader::process);
+    connect(m_loader, &ThumbnailLoader::progress, this, &CachePrewarmer::onProgress);
+    connect(m_loader, &ThumbnailLoader::idle, this, &CachePrewarmer::onIdle);
+
+    fprintf(stderr, "Pre-warming thumbnails for %s%s with %d jobs, cache limit %.0f MB\n",
+            qPrintable(QDir(folder).absolutePath()), recursive ? " (recursive)" : "", jobs, m_maxBytes / kMB);
+    m_elapsed.start();
+    m_lastPrint.start();
+    m_thread.start();
+    m_scanner->start(folder, recursive);
+}
+
+void CachePrewarmer::onFilesFound(const QVector<ScannedFile>& files) {
+    QStringList paths;
+    paths.reserve(files.size());
+    for (const ScannedFile& file : files) paths << file.path;
+    m_found += paths.size();
+    m_loader->appendPaths(paths);
+}
+
+void CachePrewarmer::onScanFinished() {
+    m_scanDone = true;
+    if (m_found == 0) {
+        fprintf(stderr, "Pre-warm: no images found\n");
+        finish(Complete);
+    } else if (m_lastIdlePaths == m_found) {
+        // The loader drained everything before the scan ended and won't
+        // report idle again
+        finish(Complete);
+    }
+}
+
+void CachePrewarmer::onProgress(const ThumbnailProgress& progress) {
+    if (m_finished) return;
+    m_last = progress;
+
+    // Entries from other folders are evicted LRU to make room, so the cache
+    // is only full once this folder's own thumbnails reach the clean-down
+    // mark; past that the loader would evict what we just made
+    qint64 folderBytes = progress.generatedBytes + progress.cachedBytes;
+    if (folderBytes >= m_maxBytes * ThumbnailLoader::kCleanTarget) {
+        finish(CacheFull);
+        return;
+    }
+    if (m_interactive || m_lastPrint.elapsed() >= kLogIntervalMs) printProgress(progress, false);
+}
+
+void CachePrewarmer::onIdle(int paths) {
+    m_lastIdlePaths = paths;
+    // Idle over a partial list means more batches are still on their way
+    if (m_finished || !m_scanDone || paths != m_found) return;
+    finish(Complete);
+}
+
+void CachePrewarmer::printProgress(const ThumbnailProgress& progress, bool final) {
+    m_lastPrint.restart();
+    int done = qMin(m_found, progress.generated + progress.cached);
+    double seconds = m_elapsed.elapsed() / 1000.0;
+    double rate = seconds > 0 ? progress.generated / seconds : 0.0;
+
+    QString eta = "scanning";
+    if (m_scanDone) {
+        int left = m_found - done;
+        eta = left <= 0 ? QString("0:00") : rate > 0 ? duration((qint64)(left / rate)) : QString("--:--");
+    }
+    QString line = QString("[%1%] %2/%3 images, %4 new, %5/s, ETA %6, cache %7/%8 MB")
+                       .arg(m_found > 0 ? done * 100 / m_found : 0, 3)
+                       .arg(done).arg(m_found).arg(progress.generated)
+                       .arg(rate, 0, 'f', 1).arg(eta)
+                       .arg(progress.cacheBytes / kMB, 0, 'f', 0).arg(m_maxBytes / kMB, 0, 'f', 0);
+    if (m_interactive) fprintf(stderr, "\r%-100s%s", qPrintable(line), final ? "\n" : "");
+    else fprintf(stderr, "%s\n", qPrintable(line));
+    fflush(stderr);
+}
+
+void CachePrewarmer::finish(ExitCode code) {
+    if (m_finished) return;
+    m_finished = true;
+
+    m_scanner->cancel();
+    if (m_loader) {
+        // Drains the jobs in flight, trims the cache back under the limit
+        // if needed and checkpoints the metadata
+        m_loader->stop();
+        m_thread.quit();
+        m_thread.wait();
+        delete m_loader;
+        m_loader = nullptr;
+        printProgress(m_last, true);
+    }
+
+    qint64 seconds = m_elapsed.isValid() ? m_elapsed.elapsed() / 1000 : 0;
+    int skipped = qMax(0, m_found - m_last.generated - m_last.cached);
+    if (code == CacheFull) {
+        fprintf(stderr, "Pre-warm stopped: this folder's thumbnails fill the cache (cache_max_size_mb = %.0f). "
+                        "%d of %d images generated, %d already cached; raise the limit to cover the rest.\n",
+                m_maxBytes / kMB, m_last.generated, m_found, m_last.cached);
+    } else if (code == Complete && m_found > 0) {
+        fprintf(stderr, "Pre-warm complete in %s: %d images, %d generated, %d already cached, "
+                        "%d duplicates or unreadable; cache %.0f/%.0f MB.\n",
+                qPrintable(duration(seconds)), m_found, m_last.generated, m_last.cached, skipped,
+                m_last.cacheBytes / kMB, m_maxBytes / kMB);
+    }
+    emit finished(code);
+}
@@ -0,0 +1,56 @@
+#ifndef CACHEPREWARMER_H
+#define CACHEPREWARMER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QVector>
+#include "DirectoryScanner.h"
+#include "ThumbnailLoader.h"
+
+// Headless `--prewarm`: scans a folder and has a ThumbnailLoader generate
+// every missing thumbnail on all cores, printing progress and an ETA to
+// stderr. Thumbnails from other folders are evicted least recently used first
+// to make room; it stops early only once this folder's own thumbnails fill
+// the cache, since anything generated past that would only be evicted again.
+class CachePrewarmer : public QObject {
+    Q_OBJECT
+public:
+    enum ExitCode {
+        Complete = 0,
+        Failed = 1,
+        CacheFull = 3
+    };
+
+    explicit CachePrewarmer(QObject* parent = nullptr);
+    ~CachePrewarmer();
+
+    // jobs <= 0 means one per core. finished() is emitted once either way.
+    void start(const QString& folder, bool recursive, int jobs);
+
+signals:
+    void finished(int exitCode);
+
+private:
+    void onFilesFound(const QVector<ScannedFile>& files);
+    void onScanFinished();
+    void onProgress(const ThumbnailProgress& progress);
+    void onIdle(int paths);
+    void finish(ExitCode code);
+    void printProgress(const ThumbnailProgress& progress, bool final);
+
+    DirectoryScanner* m_scanner;
+    ThumbnailLoader* m_loader;
+    QThread m_thread;
+    QElapsedTimer m_elapsed;
+    QElapsedTimer m_lastPrint;
+    qint64 m_maxBytes;
+    int m_found;
+    int m_lastIdlePaths; // Path count at the loader's last idle, -1 before any
+    bool m_scanDone;
+    bool m_finished;
+    bool m_interactive; // stderr is a terminal: redraw one line
+    ThumbnailProgress m_last;
+};
+
+#endif // CACHEPREWARMER_H
@@ -11,7 +11,8 @@ ConfigManager& ConfigManager::instance() {
 
 ConfigManager::ConfigManager()
     : m_recursive(true), m_slideDuration(3.0), m_transitionTime(0.5),
-      m_randomOrder(false), m_continuousLoop(true), m_cacheMaxSizeMB(512.0)
+      m_randomOrder(false), m_continuousLoop(true), m_cacheMaxSizeMB(512.0),
+      m_slideCacheMaxSizeMB(256.0), m_kenBurns(false), m_metricsPort(0)
 {
     m_configDir = QStandardPaths::writableLocation(QStandardPaths::ConfigLocation) + "/Endless_Slides";
     m_configFile = m_configDir + "/config.json";
@@ -50,6 +51,15 @@ void ConfigManager::load() {
         double val = obj["cache_max_size_mb"].toDouble();
         if (val >= 1.0) m_cacheMaxSizeMB = val;
     }
+    if (obj.contains("slide_cache_max_size_mb")) {
+        double val = obj["slide_cache_max_size_mb"].toDouble();
+        if (val >= 0.0) m_slideCacheMaxSizeMB = val; // 0 turns it off
+    }
+    if (obj.contains("ken_burns")) m_kenBurns = obj["ken_burns"].toBool();
+    if (obj.contains("metrics_port")) {
+        int val = obj["metrics_port"].toInt();
+        if (val >= 0 && val <= 65535) m_metricsPort = val;
+    }
 }
 
 void ConfigManager::save() {
@@ -61,6 +71,9 @@ void ConfigManager::save() {
     obj["random_order"] = m_randomOrder;
     obj["continuous_loop"] = m_continuousLoop;
     obj["cache_max_size_mb"] = m_cacheMaxSizeMB;
+    obj["slide_cache_max_size_mb"] = m_slideCacheMaxSizeMB;
+    obj["ken_burns"] = m_kenBurns;
+    obj["metrics_port"] = m_metricsPort;
 
     QJsonDocument doc(obj);
     QFile file(m_configFile);
@@ -90,3 +103,12 @@ void ConfigManager::setContinuousLoop(bool loop) { m_continuousLoop = loop; }
 
 double ConfigManager::cacheMaxSizeMB() const { return m_cacheMaxSizeMB; }
 void ConfigManager::setCacheMaxSizeMB(double size) { m_cacheMaxSizeMB = size; }
+
+double ConfigManager::slideCacheMaxSizeMB() const { return m_slideCacheMaxSizeMB; }
+void ConfigManager::setSlideCacheMaxSizeMB(double size) { m_slideCacheMaxSizeMB = size; }
+
+bool ConfigManager::kenBurns() const { return m_kenBurns; }
+void ConfigManager::setKenBurns(bool enabled) { m_kenBurns = enabled; }
+
+int ConfigManager::metricsPort() const { return m_metricsPort; }
+void ConfigManager::setMetricsPort(int port) { m_metricsPort = port; }
@@ -35,6 +35,18 @@ public:
     double cacheMaxSizeMB() const;
     void setCacheMaxSizeMB(double size);
 
+    // Decoded, screen-sized slides kept in memory by the slideshow
+    double slideCacheMaxSizeMB() const;
+    void setSlideCacheMaxSizeMB(double size);
+
+    // Slow pan/zoom over each slide instead of a static picture
+    bool kenBurns() const;
+    void setKenBurns(bool enabled);
+
+    // Prometheus endpoint on 127.0.0.1; 0 leaves it off
+    int metricsPort() const;
+    void setMetricsPort(int port);
+
 private:
     ConfigManager();
     ~ConfigManager() = default;
@@ -48,6 +60,9 @@ private:
     bool m_randomOrder;
     bool m_continuousLoop;
     double m_cacheMaxSizeMB;
+    double m_slideCacheMaxSizeMB;
+    bool m_kenBurns;
+    int m_metricsPort;
 
     QString m_configDir;
     QString m_configFile;
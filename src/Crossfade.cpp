@@ -0,0 +1,159 @@
+#include "Crossfade.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CROSSFADE_SSE2
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CROSSFADE_AVX2
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CROSSFADE_NEON
+#define CROSSFADE_NEON_TARGET
+#elif defined(__arm__) && defined(__linux__) && defined(__ARM_FP) && defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 8
+// armhf distros (Pi OS included) build for VFP only, so build the kernel for
+// NEON anyway and check the CPU at runtime. GCC 8's arm_neon.h allows this.
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#define CROSSFADE_NEON
+#define CROSSFADE_NEON_RUNTIME
+#define CROSSFADE_NEON_TARGET __attribute__((target("fpu=neon")))
+#endif
+
+namespace {
+// Two channels at a time in one 32-bit word: 0x00RR00BB and 0x00AA00GG.
+// Each lane peaks at 255 * 256, so nothing carries into its neighbour.
+inline quint32 blendPixel(quint32 from, quint32 to, quint32 alpha, quint32 inverse) {
+    quint32 rb = ((from & 0x00ff00ff) * inverse + (to & 0x00ff00ff) * alpha) >> 8;
+    quint32 ag = ((from >> 8) & 0x00ff00ff) * inverse + ((to >> 8) & 0x00ff00ff) * alpha;
+    return (rb & 0x00ff00ff) | (ag & 0xff00ff00);
+}
+
+void blendScalar(const quint32* from, const quint32* to, quint32* out, int count, int alpha) {
+    quint32 inverse = 256 - alpha;
+    for (int i = 0; i < count; ++i) out[i] = blendPixel(from[i], to[i], alpha, inverse);
+}
+
+#ifdef CROSSFADE_SSE2
+// Widen to 16 bits per channel, multiply-add, narrow back: 4 pixels a step
+void blendSse2(const quint32* from, const quint32* to, quint32* out, int count, int alpha) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i a = _mm_set1_epi16((short)alpha);
+    const __m128i ia = _mm_set1_epi16((short)(256 - alpha));
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i f = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from + i));
+        __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(to + i));
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(f, zero), ia),
+                                   _mm_mullo_epi16(_mm_unpacklo_epi8(t, zero), a));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(f, zero), ia),
+                                   _mm_mullo_epi16(_mm_unpackhi_epi8(t, zero), a));
+        lo = _mm_srli_epi16(lo, 8);
+        hi = _mm_srli_epi16(hi, 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(lo, hi));
+    }
+    blendScalar(from + i, to + i, out + i, count - i, alpha);
+}
+#endif
+
+#ifdef CROSSFADE_AVX2
+// Same as SSE2, 8 pixels a step. Unpack and pack both work within 128-bit
+// lanes, so the pixel order comes out unchanged.
+__attribute__((target("avx2")))
+void blendAvx2(const quint32* from, const quint32* to, quint32* out, int count, int alpha) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i a = _mm256_set1_epi16((short)alpha);
+    const __m256i ia = _mm256_set1_epi16((short)(256 - alpha));
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i f = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(from + i));
+        __m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(to + i));
+        __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(f, zero), ia),
+                                      _mm256_mullo_epi16(_mm256_unpacklo_epi8(t, zero), a));
+        __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(f, zero), ia),
+                                      _mm256_mullo_epi16(_mm256_unpackhi_epi8(t, zero), a));
+        lo = _mm256_srli_epi16(lo, 8);
+        hi = _mm256_srli_epi16(hi, 8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_packus_epi16(lo, hi));
+    }
+    blendScalar(from + i, to + i, out + i, count - i, alpha);
+}
+#endif
+
+#ifdef CROSSFADE_NEON
+// 4 pixels a step; alpha can be 256, so the weights live in 16-bit lanes
+CROSSFADE_NEON_TARGET
+void blendNeon(const quint32* from, const quint32* to, quint32* out, int count, int alpha) {
+    const uint16x8_t a = vdupq_n_u16((uint16_t)alpha);
+    const uint16x8_t ia = vdupq_n_u16((uint16_t)(256 - alpha));
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        uint8x16_t f = vreinterpretq_u8_u32(vld1q_u32(from + i));
+        uint8x16_t t = vreinterpretq_u8_u32(vld1q_u32(to + i));
+        uint16x8_t lo = vmlaq_u16(vmulq_u16(vmovl_u8(vget_low_u8(f)), ia), vmovl_u8(vget_low_u8(t)), a);
+        uint16x8_t hi = vmlaq_u16(vmulq_u16(vmovl_u8(vget_high_u8(f)), ia), vmovl_u8(vget_high_u8(t)), a);
+        uint8x16_t result = vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8));
+        vst1q_u32(out + i, vreinterpretq_u32_u8(result));
+    }
+    blendScalar(from + i, to + i, out + i, count - i, alpha);
+}
+#endif
+
+struct Dispatch {
+    Crossfade::Kernel kernel;
+    const char* name;
+};
+
+Dispatch pickKernel() {
+    if (Crossfade::Kernel k = Crossfade::avx2Kernel()) return {k, "avx2"};
+    if (Crossfade::Kernel k = Crossfade::sse2Kernel()) return {k, "sse2"};
+    if (Crossfade::Kernel k = Crossfade::neonKernel()) return {k, "neon"};
+    return {blendScalar, "scalar"};
+}
+
+const Dispatch& dispatch() {
+    static const Dispatch picked = pickKernel();
+    return picked;
+}
+}
+
+void Crossfade::blend(const quint32* from, const quint32* to, quint32* out, int count, int alpha) {
+    dispatch().kernel(from, to, out, count, qBound(0, alpha, 256));
+}
+
+const char* Crossfade::kernelName() {
+    return dispatch().name;
+}
+
+Crossfade::Kernel Crossfade::scalarKernel() {
+    return blendScalar;
+}
+
+Crossfade::Kernel Crossfade::sse2Kernel() {
+#ifdef CROSSFADE_SSE2
+    return blendSse2;
+#else
+    return nullptr;
+#endif
+}
+
+Crossfade::Kernel Crossfade::avx2Kernel() {
+#ifdef CROSSFADE_AVX2
+    if (__builtin_cpu_supports("avx2")) return blendAvx2;
+#endif
+    return nullptr;
+}
+
+Crossfade::Kernel Crossfade::neonKernel() {
+#if defined(CROSSFADE_NEON_RUNTIME)
+    if (getauxval(AT_HWCAP) & HWCAP_NEON) return blendNeon;
+#elif defined(CROSSFADE_NEON)
+    return blendNeon;
+#endif
+    return nullptr;
+}
@@ -0,0 +1,24 @@
+#ifndef CROSSFADE_H
+#define CROSSFADE_H
+
+#include <QtGlobal>
+
+// Mixes two rows of premultiplied 32-bit pixels with a fixed-point weight:
+// out = (from * (256 - alpha) + to * alpha) >> 8 per channel, alpha 0..256.
+// Picks the widest kernel the CPU has (AVX2, SSE2, NEON, else scalar) on
+// first use; every kernel gives bit-identical results.
+class Crossfade {
+public:
+    static void blend(const quint32* from, const quint32* to, quint32* out, int count, int alpha);
+    static const char* kernelName();
+
+    // Individual kernels, for benchmarking and cross-checking. Null if the
+    // build or CPU doesn't have them.
+    typedef void (*Kernel)(const quint32*, const quint32*, quint32*, int, int);
+    static Kernel scalarKernel();
+    static Kernel sse2Kernel();
+    static Kernel avx2Kernel();
+    static Kernel neonKernel();
+};
+
+#endif // CROSSFADE_H
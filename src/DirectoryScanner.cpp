@@ -0,0 +1,183 @@
+#include "DirectoryScanner.h"
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QRunnable>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QAtomicInt>
+#include <QThread>
+
+namespace {
+const int kBatchSize = 512;
+const int kBatchIntervalMs = 100;
+}
+
+// Shared by every task of one scan
+struct ScanState {
+    DirectoryScanner* scanner;
+    int scanId;
+    bool recursive;
+    QAtomicInt cancelled;
+    QAtomicInt pending; // Directory tasks queued or running
+    QAtomicInt files;
+    QAtomicInt directories;
+
+    // Filled by workers, taken by the GUI thread in deliverBatch()
+    QMutex batchMutex;
+    QVector<ScannedFile> batch;
+    QStringList batchDirs;
+    QElapsedTimer batchTimer;
+    QAtomicInt posted; // A deliverBatch() is already queued
+
+    // Wakes the GUI thread if the batch is big or old enough
+    void flush() {
+        {
+            QMutexLocker locker(&batchMutex);
+            if (batch.isEmpty()) return;
+            if (batch.size() < kBatchSize && batchTimer.elapsed() < kBatchIntervalMs) return;
+        }
+        if (posted.testAndSetOrdered(0, 1)) {
+            QMetaObject::invokeMethod(scanner, "deliverBatch", Qt::QueuedConnection,
+                                      Q_ARG(int, scanId));
+        }
+    }
+};
+
+// Lists one directory; subdirectories become new tasks on the same pool
+class ScanTask : public QRunnable {
+public:
+    ScanTask(QSharedPointer<ScanState> state, QThreadPool* pool, const QString& dir)
+        : m_state(state), m_pool(pool), m_dir(dir)
+    {
+    }
+
+    void run() override {
+        if (!m_state->cancelled.loadAcquire()) scan();
+
+        m_state->directories.fetchAndAddRelaxed(1);
+        if (m_state->pending.fetchAndAddOrdered(-1) == 1) {
+            // Last task of the scan; the GUI side drains what's left
+            if (!m_state->cancelled.loadAcquire()) {
+                QMetaObject::invokeMethod(m_state->scanner, "deliverFinished", Qt::QueuedConnection,
+                                          Q_ARG(int, m_state->scanId));
+            }
+        }
+    }
+
+private:
+    void scan() {
+        QVector<ScannedFile> found;
+        QElapsedTimer sinceHandOff;
+        sinceHandOff.start();
+        QDirIterator it(m_dir, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+        while (it.hasNext()) {
+            if (m_state->cancelled.loadAcquire()) return;
+
+            QString path = it.next();
+            QFileInfo info = it.fileInfo();
+            if (info.isDir()) {
+                // Same as QDirIterator::Subdirectories: don't follow linked dirs
+                if (m_state->recursive && !info.isSymLink()) {
+                    m_state->pending.fetchAndAddOrdered(1);
+                    m_pool->start(new ScanTask(m_state, m_pool, path));
+                }
+            } else if (DirectoryScanner::isImageFile(info.fileName())) {
+                found.append({path, info.size(), info.lastModified().toMSecsSinceEpoch()});
+                // A huge flat folder streams in as it's listed, not at the end
+                if (found.size() >= kBatchSize || sinceHandOff.elapsed() >= kBatchIntervalMs) {
+                    handOff(found, false);
+                    sinceHandOff.restart();
+                }
+            }
+        }
+
+        handOff(found, true);
+    }
+
+    void handOff(QVector<ScannedFile>& found, bool done) {
+        m_state->files.fetchAndAddRelaxed(found.size());
+        {
+            QMutexLocker locker(&m_state->batchMutex);
+            m_state->batch << found;
+            if (done) m_state->batchDirs << m_dir;
+        }
+        found.clear();
+        m_state->flush();
+    }
+
+    QSharedPointer<ScanState> m_state;
+    QThreadPool* m_pool;
+    QString m_dir;
+};
+
+DirectoryScanner::DirectoryScanner(QObject* parent)
+    : QObject(parent), m_scanId(0), m_running(false)
+{
+    // Mostly waiting on the filesystem (NAS round trips), so oversubscribe
+    m_pool.setMaxThreadCount(QThread::idealThreadCount() * 2);
+}
+
+DirectoryScanner::~DirectoryScanner() {
+    cancel();
+    m_pool.waitForDone();
+}
+
+bool DirectoryScanner::isImageFile(const QString& fileName) {
+    QString suffix = fileName.section('.', -1).toLower();
+    return suffix == "png" || suffix == "jpg" || suffix == "jpeg" ||
+           suffix == "bmp" || suffix == "gif";
+}
+
+void DirectoryScanner::start(const QString& root, bool recursive) {
+    cancel();
+
+    m_state.reset(new ScanState);
+    m_state->scanner = this;
+    m_state->scanId = ++m_scanId;
+    m_state->recursive = recursive;
+    m_state->pending.storeRelease(1);
+    m_state->batchTimer.start();
+    m_running = true;
+
+    m_pool.start(new ScanTask(m_state, &m_pool, root));
+}
+
+void DirectoryScanner::cancel() {
+    if (m_state) {
+        m_state->cancelled.storeRelease(1);
+        m_state.reset();
+    }
+    m_pool.clear(); // Drop queued directories; running ones notice the flag
+    m_running = false;
+}
+
+void DirectoryScanner::deliverBatch(int scanId) {
+    if (scanId != m_scanId || !m_running) return;
+
+    QVector<ScannedFile> files;
+    QStringList dirs;
+    int fileCount = m_state->files.loadAcquire();
+    int dirCount = m_state->directories.loadAcquire();
+    {
+        QMutexLocker locker(&m_state->batchMutex);
+        files.swap(m_state->batch);
+        dirs.swap(m_state->batchDirs);
+        m_state->batchTimer.restart();
+        m_state->posted.storeRelease(0);
+    }
+
+    // Handlers may restart the scan; nothing below touches m_state
+    if (!dirs.isEmpty()) emit directoriesFound(dirs);
+    if (!files.isEmpty()) emit filesFound(files);
+    emit progress(fileCount, dirCount);
+}
+
+void DirectoryScanner::deliverFinished(int scanId) {
+    if (scanId != m_scanId || !m_running) return;
+    deliverBatch(scanId);
+    if (scanId != m_scanId || !m_running) return;
+    m_running = false;
+    m_state.reset();
+    emit finished();
+}
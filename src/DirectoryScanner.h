@@ -0,0 +1,51 @@
+#ifndef DIRECTORYSCANNER_H
+#define DIRECTORYSCANNER_H
+
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+#include <QSharedPointer>
+#include <QVector>
+
+struct ScanState;
+
+struct ScannedFile {
+    QString path;
+    qint64 size;
+    qint64 lastModified; // msecs since epoch
+};
+
+// Walks a folder tree on a pool of workers, one task per directory, and
+// streams image files back in batches as they are found. Starting a new scan
+// cancels the running one; anything still in flight from it is dropped.
+class DirectoryScanner : public QObject {
+    Q_OBJECT
+public:
+    explicit DirectoryScanner(QObject* parent = nullptr);
+    ~DirectoryScanner();
+
+    void start(const QString& root, bool recursive);
+    void cancel();
+    bool isRunning() const { return m_running; }
+
+    static bool isImageFile(const QString& fileName);
+
+signals:
+    void filesFound(QVector<ScannedFile> files);
+    void directoriesFound(QStringList directories); // Every directory listed, root included
+    void progress(int files, int directories);
+    void finished();
+
+private slots:
+    // Queued from workers; stale scan ids are ignored
+    void deliverBatch(int scanId);
+    void deliverFinished(int scanId);
+
+private:
+    QThreadPool m_pool;
+    QSharedPointer<ScanState> m_state;
+    int m_scanId;
+    bool m_running;
+};
+
+#endif // DIRECTORYSCANNER_H
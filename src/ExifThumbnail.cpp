@@ -0,0 +1,127 @@
+#include "ExifThumbnail.h"
+#include <QFile>
+#include <QTransform>
+
+namespace {
+const int kMaxMarkers = 16; // Exif sits right after SOI/JFIF; don't wander
+
+// Bounds-checked reads over the TIFF structure inside the APP1 payload
+struct TiffReader {
+    const uchar* data;
+    int size;
+    bool littleEndian;
+
+    bool u16(qint64 off, quint16* out) const {
+        if (off < 0 || off + 2 > size) return false;
+        const uchar* p = data + off;
+        *out = littleEndian ? (p[0] | (p[1] << 8)) : ((p[0] << 8) | p[1]);
+        return true;
+    }
+
+    bool u32(qint64 off, quint32* out) const {
+        if (off < 0 || off + 4 > size) return false;
+        const uchar* p = data + off;
+        *out = littleEndian
+            ? (quint32(p[0]) | (quint32(p[1]) << 8) | (quint32(p[2]) << 16) | (quint32(p[3]) << 24))
+            : ((quint32(p[0]) << 24) | (quint32(p[1]) << 16) | (quint32(p[2]) << 8) | quint32(p[3]));
+        return true;
+    }
+};
+
+// Returns the APP1 "Exif\0\0" payload (starting at the TIFF header) or empty
+QByteArray readExifSegment(QFile& file) {
+    uchar soi[2];
+    if (file.read(reinterpret_cast<char*>(soi), 2) != 2 || soi[0] != 0xFF || soi[1] != 0xD8) {
+        return QByteArray();
+    }
+
+    for (int i = 0; i < kMaxMarkers; ++i) {
+        uchar marker[4];
+        if (file.read(reinterpret_cast<char*>(marker), 4) != 4 || marker[0] != 0xFF) break;
+
+        int type = marker[1];
+        int length = (marker[2] << 8) | marker[3];
+        if (length < 2) break;
+        if (type == 0xDA || type == 0xD9) break; // Image data starts; no EXIF
+
+        if (type == 0xE1) {
+            QByteArray payload = file.read(length - 2);
+            if (payload.size() == length - 2 && payload.startsWith(QByteArray("Exif\0\0", 6))) {
+                return payload.mid(6);
+            }
+        } else if (!file.seek(file.pos() + length - 2)) {
+            break;
+        }
+    }
+    return QByteArray();
+}
+
+QImage applyOrientation(const QImage& img, int orientation) {
+    // Same mapping Qt's JPEG handler uses for autoTransform
+    switch (orientation) {
+    case 2: return img.mirrored(true, false);
+    case 3: return img.transformed(QTransform().rotate(180));
+    case 4: return img.mirrored(false, true);
+    case 5: return img.mirrored(false, true).transformed(QTransform().rotate(90));
+    case 6: return img.transformed(QTransform().rotate(90));
+    case 7: return img.mirrored(true, false).transformed(QTransform().rotate(90));
+    case 8: return img.transformed(QTransform().rotate(270));
+    default: return img;
+    }
+}
+}
+
+QImage ExifThumbnail::read(const QString& path, int minEdge) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return QImage();
+
+    QByteArray exif = readExifSegment(file);
+    if (exif.size() < 8) return QImage();
+
+    TiffReader tiff;
+    tiff.data = reinterpret_cast<const uchar*>(exif.constData());
+    tiff.size = exif.size();
+    if (exif.startsWith("II")) tiff.littleEndian = true;
+    else if (exif.startsWith("MM")) tiff.littleEndian = false;
+    else return QImage();
+
+    quint16 magic = 0;
+    quint32 ifd0 = 0;
+    if (!tiff.u16(2, &magic) || magic != 42 || !tiff.u32(4, &ifd0)) return QImage();
+
+    // IFD0: orientation, then the link to IFD1
+    quint16 count = 0;
+    if (!tiff.u16(ifd0, &count)) return QImage();
+
+    int orientation = 1;
+    for (int i = 0; i < count; ++i) {
+        qint64 entry = ifd0 + 2 + i * 12;
+        quint16 tag = 0, value = 0;
+        if (!tiff.u16(entry, &tag)) return QImage();
+        if (tag == 0x0112 && tiff.u16(entry + 8, &value)) orientation = value;
+    }
+
+    quint32 ifd1 = 0;
+    if (!tiff.u32(ifd0 + 2 + count * 12, &ifd1) || ifd1 == 0) return QImage();
+
+    // IFD1: the embedded JPEG's offset and length
+    if (!tiff.u16(ifd1, &count)) return QImage();
+
+    quint32 offset = 0, length = 0;
+    for (int i = 0; i < count; ++i) {
+        qint64 entry = ifd1 + 2 + i * 12;
+        quint16 tag = 0;
+        if (!tiff.u16(entry, &tag)) return QImage();
+        if (tag == 0x0201) tiff.u32(entry + 8, &offset);
+        else if (tag == 0x0202) tiff.u32(entry + 8, &length);
+    }
+
+    if (offset == 0 || length == 0 || (qint64)offset + length > tiff.size) return QImage();
+
+    QImage thumb = QImage::fromData(tiff.data + offset, length, "JPG");
+    if (thumb.isNull()) return QImage();
+
+    thumb = applyOrientation(thumb, orientation);
+    if (qMax(thumb.width(), thumb.height()) < minEdge) return QImage();
+    return thumb;
+}
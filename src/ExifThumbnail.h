@@ -0,0 +1,17 @@
+#ifndef EXIFTHUMBNAIL_H
+#define EXIFTHUMBNAIL_H
+
+#include <QString>
+#include <QImage>
+
+// Fast path for camera JPEGs: pulls the thumbnail embedded in the EXIF APP1
+// segment (IFD1) instead of decoding the full original. Only the header
+// segments of the file are read.
+class ExifThumbnail {
+public:
+    // Embedded thumbnail with EXIF orientation applied, or a null image if
+    // there is none or its longest edge is below minEdge
+    static QImage read(const QString& path, int minEdge);
+};
+
+#endif // EXIFTHUMBNAIL_H
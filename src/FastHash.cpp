@@ -0,0 +1,114 @@
+#include "FastHash.h"
+#include <QFile>
+#include <QByteArray>
+#include <QtEndian>
+
+namespace {
+const quint64 kPrime1 = 0x9E3779B185EBCA87ULL;
+const quint64 kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+const quint64 kPrime3 = 0x165667B19E3779F9ULL;
+const quint64 kPrime4 = 0x85EBCA77C2B2AE63ULL;
+const quint64 kPrime5 = 0x27D4EB2F165667C5ULL;
+
+const qint64 kSampleBytes = 64 * 1024;
+
+inline quint64 rotl(quint64 x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+inline quint64 xxRound(quint64 acc, quint64 input) {
+    acc += input * kPrime2;
+    acc = rotl(acc, 31);
+    return acc * kPrime1;
+}
+
+inline quint64 mergeRound(quint64 acc, quint64 value) {
+    acc ^= xxRound(0, value);
+    return acc * kPrime1 + kPrime4;
+}
+
+inline quint64 read64(const uchar* p) { return qFromLittleEndian<quint64>(p); }
+inline quint32 read32(const uchar* p) { return qFromLittleEndian<quint32>(p); }
+}
+
+quint64 FastHash::xxh64(const void* data, qint64 length, quint64 seed) {
+    const uchar* p = static_cast<const uchar*>(data);
+    const uchar* end = p + length;
+    quint64 h;
+
+    if (length >= 32) {
+        // Four independent lanes over 32-byte stripes
+        const uchar* limit = end - 32;
+        quint64 v1 = seed + kPrime1 + kPrime2;
+        quint64 v2 = seed + kPrime2;
+        quint64 v3 = seed;
+        quint64 v4 = seed - kPrime1;
+        do {
+            v1 = xxRound(v1, read64(p));
+            v2 = xxRound(v2, read64(p + 8));
+            v3 = xxRound(v3, read64(p + 16));
+            v4 = xxRound(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+    } else {
+        h = seed + kPrime5;
+    }
+
+    h += (quint64)length;
+
+    while (p + 8 <= end) {
+        h ^= xxRound(0, read64(p));
+        h = rotl(h, 27) * kPrime1 + kPrime4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= (quint64)read32(p) * kPrime1;
+        h = rotl(h, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (quint64)(*p) * kPrime5;
+        h = rotl(h, 11) * kPrime1;
+        ++p;
+    }
+
+    // Avalanche
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
+
+QString FastHash::fileKey(const QString& path, qint64 size) {
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) return QString();
+
+    // Size first, so two files that share samples but not length still differ
+    QByteArray buffer;
+    buffer.reserve(8 + 3 * kSampleBytes);
+    uchar sizeBytes[8];
+    qToLittleEndian<quint64>((quint64)size, sizeBytes);
+    buffer.append(reinterpret_cast<const char*>(sizeBytes), 8);
+
+    if (size <= 3 * kSampleBytes) {
+        buffer.append(f.readAll());
+    } else {
+        const qint64 offsets[] = {0, size / 2 - kSampleBytes / 2, size - kSampleBytes};
+        for (qint64 offset : offsets) {
+            if (!f.seek(offset)) return QString();
+            buffer.append(f.read(kSampleBytes));
+        }
+    }
+    if (buffer.size() <= 8 && size > 0) return QString();
+
+    quint64 h = xxh64(buffer.constData(), buffer.size());
+    return QString("%1-%2").arg(size, 0, 16).arg(h, 16, 16, QLatin1Char('0'));
+}
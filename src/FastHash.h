@@ -0,0 +1,20 @@
+#ifndef FASTHASH_H
+#define FASTHASH_H
+
+#include <QString>
+#include <QtGlobal>
+
+// Non-cryptographic hashing for cache keys. xxHash64 (same output as the
+// reference implementation), and a content key for image files that reads
+// only a few samples instead of the whole file.
+class FastHash {
+public:
+    static quint64 xxh64(const void* data, qint64 length, quint64 seed = 0);
+
+    // Identity of the file's bytes: its size plus 64 KiB samples from the
+    // head, middle and tail. Same content gives the same key wherever the
+    // file lives. Empty if the file can't be read.
+    static QString fileKey(const QString& path, qint64 size);
+};
+
+#endif // FASTHASH_H
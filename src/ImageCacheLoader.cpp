@@ -1,40 +1,398 @@
 #include "ImageCacheLoader.h"
+#include "Trace.h"
+#include "Metrics.h"
 #include <QImageReader>
+#include <QPainter>
+#include <QElapsedTimer>
+#include <QRunnable>
+#include <QSemaphore>
 
-void ImageCacheLoader::requestImage(const QString& path, const QSize& targetSize) {
+namespace {
+// Above this many source pixels, non-JPEG slides are read whole and then
+// converted and scaled here in parallel. JPEG already scales cheaply inside
+// the decoder (DCT scaling), so it keeps using setScaledSize().
+const qint64 kLargeImagePixels = 16 * 1000 * 1000;
+const int kStripRows = 32; // Destination rows per strip
+// Pyramid top level, relative to the size that just covers the view. The
+// deepest pan/zoom this supports without upsampling.
+const double kPyramidZoom = 2.0;
+
+struct LoaderMetrics {
+    Metrics::Histogram* decodeSeconds;
+    Metrics::Counter* cacheHits;
+    Metrics::Counter* cacheMisses;
+    Metrics::Gauge* queueDepth;
+    Metrics::Gauge* cacheBytes;
+    Metrics::Gauge* cacheMaxBytes;
+};
+
+const LoaderMetrics& metrics() {
+    static const LoaderMetrics m = {
+        Metrics::histogram("slideshow_decode_seconds", "Slide decode time, cache misses only",
+                           {0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10}),
+        Metrics::counter("slideshow_slide_cache_hits_total", "Slide requests served from the decoded-slide cache"),
+        Metrics::counter("slideshow_slide_cache_misses_total", "Slide requests that needed a decode"),
+        Metrics::gauge("slideshow_decode_queue_depth", "Slide requests waiting for a decode worker"),
+        Metrics::gauge("slideshow_slide_cache_bytes", "Decoded slides held in memory"),
+        Metrics::gauge("slideshow_slide_cache_max_bytes", "Limit for slideshow_slide_cache_bytes (slide_cache_max_size_mb)"),
+    };
+    return m;
+}
+
+// Source column/row where destination pixel i starts; entry n is the end
+QVector<int> boxEdges(int from, int to) {
+    QVector<int> edges(to + 1);
+    for (int i = 0; i <= to; ++i) edges[i] = (int)((qint64)i * from / to);
+    return edges;
+}
+
+// Box-filters one strip of destination rows straight into the frame.
+// Converts just the source rows it needs, so conversion is split the same
+// way as scaling. Works bytewise on 32-bit pixels; premultiplied, so
+// averaging channels is correct.
+class StripTask : public QRunnable {
+public:
+    StripTask(const QImage& src, uchar* dst, int dstStride, int y0, int y1,
+              const QVector<int>* xEdges, const QVector<int>* yEdges, QSemaphore* done)
+        : m_src(src), m_dst(dst), m_dstStride(dstStride), m_y0(y0), m_y1(y1),
+          m_xEdges(xEdges), m_yEdges(yEdges), m_done(done)
+    {
+    }
+
+    void run() override {
+        TRACE_SCOPE("slide.strip");
+        const QVector<int>& xEdges = *m_xEdges;
+        const QVector<int>& yEdges = *m_yEdges;
+        int top = yEdges[m_y0];
+        int rows = yEdges[m_y1] - top;
+
+        // Shallow view of our rows; the conversion is the only copy
+        QImage band(m_src.constScanLine(top), m_src.width(), rows, m_src.bytesPerLine(), m_src.format());
+        if (m_src.format() == QImage::Format_Indexed8 || m_src.format() == QImage::Format_Mono ||
+            m_src.format() == QImage::Format_MonoLSB) {
+            band.setColorTable(m_src.colorTable());
+        }
+        band = band.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+        int width = m_xEdges->size() - 1;
+        QVector<quint32> sums(width * 4);
+        for (int y = m_y0; y < m_y1; ++y) {
+            sums.fill(0);
+            for (int sy = yEdges[y]; sy < yEdges[y + 1]; ++sy) {
+                const uchar* line = band.constScanLine(sy - top);
+                quint32* sum = sums.data();
+                for (int x = 0; x < width; ++x, sum += 4) {
+                    for (int sx = xEdges[x]; sx < xEdges[x + 1]; ++sx) {
+                        const uchar* px = line + sx * 4;
+                        sum[0] += px[0];
+                        sum[1] += px[1];
+                        sum[2] += px[2];
+                        sum[3] += px[3];
+                    }
+                }
+            }
+
+            int boxRows = yEdges[y + 1] - yEdges[y];
+            uchar* out = m_dst + (qint64)y * m_dstStride;
+            const quint32* sum = sums.constData();
+            for (int x = 0; x < width; ++x, sum += 4, out += 4) {
+                quint32 area = (quint32)((xEdges[x + 1] - xEdges[x]) * boxRows);
+                for (int c = 0; c < 4; ++c) out[c] = (uchar)((sum[c] + area / 2) / area);
+            }
+        }
+        m_done->release();
+    }
+
+private:
+    QImage m_src;
+    uchar* m_dst; // Raw rows: scanLine() isn't safe to call from several threads
+    int m_dstStride;
+    int m_y0;
+    int m_y1;
+    const QVector<int>* m_xEdges;
+    const QVector<int>* m_yEdges;
+    QSemaphore* m_done;
+};
+}
+
+// Just runs the loader's queue loop
+class DecodeWorker : public QThread {
+public:
+    explicit DecodeWorker(ImageCacheLoader* loader) : m_loader(loader) {}
+
+protected:
+    void run() override { m_loader->workerLoop(); }
+
+private:
+    ImageCacheLoader* m_loader;
+};
+
+ImageCacheLoader::ImageCacheLoader(QObject* parent)
+    : QObject(parent), m_nextToken(1), m_stopping(false), m_cacheHits(0), m_cacheMisses(0)
+{
+    // A few slides at once, not one per core: a full-size 50 MP decode is
+    // ~200 MB on its own, and big ones spread over every core in strips anyway
+    int workers = qBound(1, QThread::idealThreadCount() / 2, 4);
+    for (int i = 0; i < workers; ++i) {
+        DecodeWorker* worker = new DecodeWorker(this);
+        worker->setObjectName(QString("decode %1").arg(i + 1)); // Names the thread in traces
+        m_workers.append(worker);
+        worker->start();
+    }
+    m_stripPool.setMaxThreadCount(QThread::idealThreadCount());
+    metrics().cacheMaxBytes->set((qint64)m_cache.maxCost() * 1024);
+    
+    qRegisterMetaType<SlideFrame>("SlideFrame");
+}
+
+ImageCacheLoader::~ImageCacheLoader() {
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_cond.wakeAll();
+        metrics().queueDepth->add(-m_queue.size());
+    }
+    for (DecodeWorker* worker : m_workers) {
+        worker->wait();
+        delete worker;
+    }
+    m_stripPool.waitForDone();
+}
+
+QString ImageCacheLoader::cacheKey(const Request& req) {
+    return QString("%1@%2x%3%4").arg(req.path).arg(req.targetSize.width()).arg(req.targetSize.height())
+                                .arg(req.pyramid ? "/pyramid" : "");
+}
+
+void ImageCacheLoader::setCacheMaxSizeMB(double size) {
     QMutexLocker locker(&m_mutex);
-    // Remove if already in queue?
-    // Simple LIFO or FIFO? FIFO is usually better for "next slide" type things.
-    // If the queue is too huge, we might clear old requests.
-    if (m_queue.size() > 5) m_queue.removeFirst(); // keep it small
+    m_cache.setMaxCost(qMax(0, (int)(size * 1024)));
+    metrics().cacheMaxBytes->set((qint64)m_cache.maxCost() * 1024);
+    metrics().cacheBytes->set((qint64)m_cache.totalCost() * 1024);
+}
+
+void ImageCacheLoader::clearCache() {
+    QMutexLocker locker(&m_mutex);
+    m_cache.clear();
+    metrics().cacheBytes->set(0);
+}
+
+int ImageCacheLoader::cacheHits() const {
+    QMutexLocker locker(&m_mutex);
+    return m_cacheHits;
+}
+
+int ImageCacheLoader::cacheMisses() const {
+    QMutexLocker locker(&m_mutex);
+    return m_cacheMisses;
+}
+
+void ImageCacheLoader::enqueue(const Request& req) {
+    int pos = m_queue.size();
+    while (pos > 0 && m_queue[pos - 1].priority > req.priority) --pos;
+    m_queue.insert(pos, req);
+}
+
+quint64 ImageCacheLoader::requestImage(const QString& path, const QSize& targetSize, Priority priority,
+                                       bool pyramid) {
+    QMutexLocker locker(&m_mutex);
+    for (auto it = m_inFlight.constBegin(); it != m_inFlight.constEnd(); ++it) {
+        if (!it->cancelled && it->path == path && it->targetSize == targetSize && it->pyramid == pyramid) {
+            return it.key();
+        }
+    }
+    for (int i = 0; i < m_queue.size(); ++i) {
+        const Request& queued = m_queue[i];
+        if (queued.path != path || queued.targetSize != targetSize || queued.pyramid != pyramid) continue;
+        Request req = queued;
+        if (priority < req.priority) {
+            m_queue.removeAt(i);
+            req.priority = priority;
+            enqueue(req);
+        }
+        return req.token;
+    }
     
-    m_queue.append({path, targetSize});
+    quint64 token = m_nextToken++;
+    enqueue({token, path, targetSize, priority, pyramid});
+    metrics().queueDepth->add(1);
     m_cond.wakeOne();
+    return token;
+}
+
+void ImageCacheLoader::setPriority(quint64 token, Priority priority) {
+    QMutexLocker locker(&m_mutex);
+    for (int i = 0; i < m_queue.size(); ++i) {
+        if (m_queue[i].token != token) continue;
+        Request req = m_queue.takeAt(i);
+        req.priority = priority;
+        enqueue(req);
+        return;
+    }
 }
 
-void ImageCacheLoader::run() {
-    while (!isInterruptionRequested()) {
+void ImageCacheLoader::cancel(quint64 token) {
+    QMutexLocker locker(&m_mutex);
+    auto inFlight = m_inFlight.find(token);
+    if (inFlight != m_inFlight.end()) {
+        inFlight->cancelled = true;
+        return;
+    }
+    for (int i = 0; i < m_queue.size(); ++i) {
+        if (m_queue[i].token == token) {
+            m_queue.removeAt(i);
+            metrics().queueDepth->add(-1);
+            return;
+        }
+    }
+}
+
+void ImageCacheLoader::workerLoop() {
+    forever {
         Request req;
+        QString key;
         {
             QMutexLocker locker(&m_mutex);
-            if (m_queue.isEmpty()) {
-                m_cond.wait(&m_mutex);
-                if (isInterruptionRequested()) break;
-            }
-            if (m_queue.isEmpty()) continue;
+            while (!m_stopping && m_queue.isEmpty()) m_cond.wait(&m_mutex);
+            if (m_stopping) return;
             req = m_queue.takeFirst();
+            metrics().queueDepth->add(-1);
+            
+            // Hits still go through the queue so the reply stays asynchronous
+            key = cacheKey(req);
+            if (SlideFrame* cached = m_cache.object(key)) {
+                m_cacheHits++;
+                metrics().cacheHits->add();
+                TRACE_INSTANT("slide.cacheHit");
+                SlideFrame frame = *cached;
+                locker.unlock();
+                emit imageLoaded(req.token, req.path, frame, -1);
+                continue;
+            }
+            m_cacheMisses++;
+            metrics().cacheMisses->add();
+            m_inFlight.insert(req.token, {req.path, req.targetSize, req.pyramid, false});
+        }
+        
+        QElapsedTimer timer;
+        timer.start();
+        SlideFrame frame;
+        {
+            TRACE_SCOPE(req.pyramid ? "slide.decodePyramid" : "slide.decode");
+            frame = req.pyramid ? decodePyramid(req) : decode(req);
         }
+        bool ok = !frame.image.isNull() || !frame.levels.isEmpty();
         
-        QImageReader reader(req.path);
-        // We want to scale to fit targetSize but keep aspect ratio
-        QSize orig = reader.size();
-        if (orig.isValid()) {
-            QSize scaled = orig.scaled(req.targetSize, Qt::KeepAspectRatio);
-            reader.setScaledSize(scaled);
-            QImage img = reader.read();
-            if (!img.isNull()) {
-                emit imageLoaded(req.path, img);
+        bool cancelled;
+        {
+            QMutexLocker locker(&m_mutex);
+            cancelled = m_inFlight.take(req.token).cancelled;
+            // Cached even if cancelled; it was decoded either way.
+            // Shares pixels with what's emitted, no copy.
+            if (ok) {
+                qint64 bytes = frame.image.sizeInBytes();
+                for (const QImage& level : frame.levels) bytes += level.sizeInBytes();
+                m_cache.insert(key, new SlideFrame(frame), qMax(1, (int)(bytes / 1024)));
+                metrics().cacheBytes->set((qint64)m_cache.totalCost() * 1024);
             }
         }
+        if (ok) metrics().decodeSeconds->observe(timer.elapsed() / 1000.0);
+        if (ok && !cancelled) {
+            emit imageLoaded(req.token, req.path, frame, (int)timer.elapsed());
+        }
+    }
+}
+
+SlideFrame ImageCacheLoader::decode(const Request& req) {
+    SlideFrame result;
+    QImageReader reader(req.path);
+    // We want to scale to fit targetSize but keep aspect ratio
+    QSize orig = reader.size();
+    if (!orig.isValid()) return result;
+    QSize scaled = orig.scaled(req.targetSize, Qt::KeepAspectRatio);
+    if (scaled.isEmpty()) return result;
+    
+    // Delivered letterboxed to the full target size, premultiplied, so the
+    // widget only ever blits; no conversion or centering on the GUI thread
+    QImage frame(req.targetSize, QImage::Format_ARGB32_Premultiplied);
+    if (frame.isNull()) return result;
+    frame.fill(Qt::black);
+    QRect area(QPoint((req.targetSize.width() - scaled.width()) / 2,
+                      (req.targetSize.height() - scaled.height()) / 2), scaled);
+    
+    bool large = (qint64)orig.width() * orig.height() > kLargeImagePixels;
+    bool shrinking = scaled.width() < orig.width() && scaled.height() < orig.height();
+    if (large && shrinking && reader.format() != "jpeg") {
+        QImage full = reader.read();
+        if (full.isNull()) return result;
+        scaleInStrips(full, frame, area);
+    } else {
+        reader.setScaledSize(scaled);
+        QImage img = reader.read();
+        if (img.isNull()) return result;
+        QPainter p(&frame);
+        p.drawImage(area.topLeft(), img);
+    }
+    
+    result.image = frame;
+    result.content = area;
+    return result;
+}
+
+SlideFrame ImageCacheLoader::decodePyramid(const Request& req) {
+    SlideFrame result;
+    QImageReader reader(req.path);
+    QSize orig = reader.size();
+    if (!orig.isValid()) return result;
+    
+    // Top level: one level up from the size that just covers the view
+    // (kPyramidZoom times it), but never more than the file has
+    QSize cover = orig.scaled(req.targetSize, Qt::KeepAspectRatioByExpanding);
+    QSize top = cover * kPyramidZoom;
+    if (top.width() > orig.width() || top.height() > orig.height()) top = orig;
+    if (top.isEmpty()) return result;
+    
+    QImage level;
+    bool large = (qint64)orig.width() * orig.height() > kLargeImagePixels;
+    bool shrinking = top.width() < orig.width() && top.height() < orig.height();
+    if (large && shrinking && reader.format() != "jpeg") {
+        QImage full = reader.read();
+        if (full.isNull()) return result;
+        level = QImage(top, QImage::Format_ARGB32_Premultiplied);
+        if (level.isNull()) return result;
+        scaleInStrips(full, level, level.rect());
+    } else {
+        if (top != orig) reader.setScaledSize(top);
+        level = reader.read();
+        if (level.isNull()) return result;
+        level = level.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+    
+    // Below it only the screen-size level itself: every zoom falls between
+    // the two, and the renderer picks whichever is nearer 1:1
+    result.levels.append(level);
+    if (level.width() >= cover.width() * 5 / 4 && level.height() >= cover.height() * 5 / 4) {
+        QImage base(cover, QImage::Format_ARGB32_Premultiplied);
+        if (base.isNull()) return result;
+        scaleInStrips(level, base, base.rect());
+        result.levels.append(base);
+    }
+    return result;
+}
+
+void ImageCacheLoader::scaleInStrips(const QImage& src, QImage& frame, const QRect& area) {
+    TRACE_SCOPE("slide.scaleInStrips");
+    QVector<int> xEdges = boxEdges(src.width(), area.width());
+    QVector<int> yEdges = boxEdges(src.height(), area.height());
+    
+    int stride = frame.bytesPerLine();
+    uchar* bits = frame.bits() + (qint64)area.y() * stride + area.x() * 4;
+    QSemaphore done;
+    int strips = 0;
+    for (int y = 0; y < area.height(); y += kStripRows) {
+        m_stripPool.start(new StripTask(src, bits, stride, y, qMin(y + kStripRows, area.height()),
+                                        &xEdges, &yEdges, &done));
+        strips++;
     }
+    done.acquire(strips);
 }
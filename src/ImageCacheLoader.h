@@ -4,41 +4,106 @@
 #include <QObject>
 #include <QImage>
 #include <QMap>
+#include <QHash>
 #include <QMutex>
 #include <QCache>
 #include <QThread>
+#include <QThreadPool>
+#include <QVector>
 #include <QWaitCondition>
 
-class ImageCacheLoader : public QThread {
+class DecodeWorker;
+
+// One decoded slide, ready for the screen
+struct SlideFrame {
+    QImage image;   // Letterboxed to exactly the requested size
+    QRect content;  // Where the picture sits in image; the rest is black
+    // Pyramid requests only (image is then empty): the picture uncropped,
+    // ARGB32 premultiplied: the deepest zoom's size, then (when the file has
+    // more than that) exactly the size that covers the view
+    QVector<QImage> levels;
+};
+Q_DECLARE_METATYPE(SlideFrame)
+
+// Decodes slides on a few worker threads into screen-ready frames: the
+// requested size exactly, letterboxed in black, ARGB32 premultiplied; or,
+// for pan/zoom, a small pyramid covering the requested size with room to
+// zoom. Very large images additionally get their format conversion and
+// scaling split into strips across all cores.
+class ImageCacheLoader : public QObject {
     Q_OBJECT
 public:
-    explicit ImageCacheLoader(QObject* parent = nullptr) : QThread(parent) {
-        start();
-    }
-    ~ImageCacheLoader() {
-        requestInterruption();
-        m_cond.wakeAll();
-        wait();
-    }
+    // Lower runs first; same priority is first come, first served
+    enum Priority {
+        Current = 0,  // On screen, or a transition is waiting on it
+        Next = 1,     // Up next
+        Prefetch = 2  // Further ahead, or behind for manual navigation
+    };
 
-    void requestImage(const QString& path, const QSize& targetSize);
+    explicit ImageCacheLoader(QObject* parent = nullptr);
+    ~ImageCacheLoader();
 
-signals:
-    void imageLoaded(QString path, QImage image);
+    // Returns a token identifying the answer. Asking again for something
+    // still queued or decoding returns the same token (raising its priority
+    // if needed) rather than queueing a second decode.
+    quint64 requestImage(const QString& path, const QSize& targetSize, Priority priority = Prefetch,
+                         bool pyramid = false);
+    void setPriority(quint64 token, Priority priority);
+    // Drops a queued request; one already decoding finishes but isn't delivered
+    void cancel(quint64 token);
+
+    // Budget for decoded slides kept around for revisits and short loops
+    void setCacheMaxSizeMB(double size);
+    void clearCache();
+    int cacheHits() const;
+    int cacheMisses() const;
+    // Decodes that run side by side
+    int workerCount() const { return m_workers.size(); }
 
-protected:
-    void run() override;
+signals:
+    // decodeMs: wall time spent reading and scaling, for lead-time estimates,
+    // -1 when served from the cache.
+    void imageLoaded(quint64 token, QString path, SlideFrame frame, int decodeMs);
 
 private:
+    friend class DecodeWorker;
+
     struct Request {
+        quint64 token;
+        QString path;
+        QSize targetSize;
+        int priority;
+        bool pyramid;
+    };
+    struct InFlight {
         QString path;
         QSize targetSize;
+        bool pyramid;
+        bool cancelled;
     };
-    QList<Request> m_queue;
-    QMutex m_mutex;
+
+    static QString cacheKey(const Request& req);
+    void enqueue(const Request& req); // Caller holds m_mutex
+    void workerLoop();                // Body of every DecodeWorker
+    SlideFrame decode(const Request& req);
+    SlideFrame decodePyramid(const Request& req);
+    // Converts and box-filters src down into area of frame, in row strips on m_stripPool
+    void scaleInStrips(const QImage& src, QImage& frame, const QRect& area);
+
+    QList<Request> m_queue; // Sorted by priority
+    mutable QMutex m_mutex;
     QWaitCondition m_cond;
+    quint64 m_nextToken;
+    bool m_stopping;
+    QHash<quint64, InFlight> m_inFlight; // Being decoded right now
+    
+    QVector<DecodeWorker*> m_workers;
+    QThreadPool m_stripPool;
     
-    // QCache<QString, QImage> m_cache; // Could add caching if needed
+    // Keyed by path and target size; cost in KiB. Guarded by m_mutex.
+    QCache<QString, SlideFrame> m_cache;
+    int m_cacheHits;
+    int m_cacheMisses;
 };
 
 #endif // IMAGECACHELOADER_H
@@ -0,0 +1,166 @@
+#include "LibraryIndex.h"
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+#include <QDir>
+#include <QStandardPaths>
+#include <QDebug>
+
+namespace {
+const quint32 kIndexMagic = 0x494c5353; // "SSLI"
+const quint32 kIndexVersion = 1;
+
+bool isUnder(const QString& path, const QString& dir) {
+    return path.size() > dir.size() && path.startsWith(dir) && path.at(dir.size()) == '/';
+}
+}
+
+LibraryIndex::LibraryIndex()
+    : m_recursive(false), m_dirty(false)
+{
+    // Next to the config, not in the thumbnail dir: clearing the cache
+    // shouldn't cost a rescan
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::ConfigLocation) + "/Endless_Slides";
+    QDir().mkpath(dir);
+    m_file = dir + "/library.index";
+}
+
+void LibraryIndex::reset(const QString& root, bool recursive) {
+    m_root = root;
+    m_recursive = recursive;
+    m_entries.clear();
+    m_directories.clear();
+    m_dirty = true;
+}
+
+bool LibraryIndex::load(const QString& root, bool recursive) {
+    reset(root, recursive);
+    m_dirty = false;
+
+    QFile f(m_file);
+    if (!f.open(QIODevice::ReadOnly)) return false;
+
+    QDataStream in(&f);
+    quint32 magic = 0, version = 0, count = 0;
+    QString savedRoot;
+    bool savedRecursive = false;
+    in >> magic >> version;
+    if (magic != kIndexMagic || version != kIndexVersion) {
+        qWarning() << "Ignoring library index with unknown format";
+        return false;
+    }
+    in >> savedRoot >> savedRecursive;
+    if (savedRoot != root || savedRecursive != recursive) return false;
+
+    in >> count;
+    m_entries.reserve(count);
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QString path;
+        LibraryEntry entry;
+        in >> path >> entry.size >> entry.lastModified;
+        m_entries.insert(path, entry);
+    }
+    QStringList dirs;
+    in >> dirs;
+
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << "Library index is truncated, rescanning";
+        reset(root, recursive);
+        m_dirty = false;
+        return false;
+    }
+    for (const QString& dir : dirs) m_directories.insert(dir);
+    return true;
+}
+
+bool LibraryIndex::save() {
+    QSaveFile f(m_file);
+    if (!f.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not write library index" << m_file;
+        return false;
+    }
+
+    QDataStream out(&f);
+    out << kIndexMagic << kIndexVersion << m_root << m_recursive << (quint32)m_entries.size();
+    for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        out << it.key() << it.value().size << it.value().lastModified;
+    }
+    out << directories();
+
+    if (!f.commit()) {
+        qWarning() << "Could not commit library index" << m_file;
+        return false;
+    }
+    m_dirty = false;
+    return true;
+}
+
+void LibraryIndex::insert(const QString& path, const LibraryEntry& entry) {
+    m_entries.insert(path, entry);
+    m_dirty = true;
+}
+
+void LibraryIndex::remove(const QString& path) {
+    if (m_entries.remove(path)) m_dirty = true;
+}
+
+void LibraryIndex::addDirectory(const QString& dir) {
+    m_directories.insert(dir);
+    m_dirty = true;
+}
+
+void LibraryIndex::setDirectories(const QStringList& dirs) {
+    m_directories.clear();
+    for (const QString& dir : dirs) m_directories.insert(dir);
+    m_dirty = true;
+}
+
+QStringList LibraryIndex::removeDirectory(const QString& dir) {
+    QStringList removed;
+    for (auto it = m_entries.begin(); it != m_entries.end(); ) {
+        if (isUnder(it.key(), dir)) {
+            removed << it.key();
+            it = m_entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = m_directories.begin(); it != m_directories.end(); ) {
+        if (*it == dir || isUnder(*it, dir)) it = m_directories.erase(it);
+        else ++it;
+    }
+    m_dirty = true;
+    return removed;
+}
+
+QList<QPair<QString, QString>> LibraryIndex::renameDirectory(const QString& from, const QString& to) {
+    QList<QPair<QString, QString>> renamed;
+    QHash<QString, LibraryEntry> moved;
+    for (auto it = m_entries.begin(); it != m_entries.end(); ) {
+        if (isUnder(it.key(), from)) {
+            QString path = to + it.key().mid(from.size());
+            renamed << qMakePair(it.key(), path);
+            moved.insert(path, it.value());
+            it = m_entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = moved.constBegin(); it != moved.constEnd(); ++it) {
+        m_entries.insert(it.key(), it.value());
+    }
+
+    QStringList dirs;
+    for (auto it = m_directories.begin(); it != m_directories.end(); ) {
+        if (*it == from || isUnder(*it, from)) {
+            dirs << to + it->mid(from.size());
+            it = m_directories.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (const QString& dir : dirs) m_directories.insert(dir);
+
+    m_dirty = true;
+    return renamed;
+}
@@ -0,0 +1,57 @@
+#ifndef LIBRARYINDEX_H
+#define LIBRARYINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QPair>
+#include <QList>
+
+struct LibraryEntry {
+    qint64 size;
+    qint64 lastModified; // msecs since epoch
+};
+
+// On-disk list of every image under the library folder, with size and mtime,
+// so startup can show the library without walking the tree first. Kept
+// current by the watcher and by background rescans; one file, rewritten
+// atomically on save. GUI thread only.
+class LibraryIndex {
+public:
+    LibraryIndex();
+
+    // False if there is no index, it's in an old format, or it was built
+    // for another folder / recursion setting. Leaves the index empty then.
+    bool load(const QString& root, bool recursive);
+    bool save();
+    void reset(const QString& root, bool recursive);
+
+    const QString& root() const { return m_root; }
+    bool recursive() const { return m_recursive; }
+    bool isDirty() const { return m_dirty; }
+
+    const QHash<QString, LibraryEntry>& entries() const { return m_entries; }
+    bool contains(const QString& path) const { return m_entries.contains(path); }
+    QStringList paths() const { return m_entries.keys(); }
+    QStringList directories() const { return m_directories.values(); }
+
+    void insert(const QString& path, const LibraryEntry& entry);
+    void remove(const QString& path);
+    void addDirectory(const QString& dir);
+    void setDirectories(const QStringList& dirs);
+    // Drops the directory and everything below it; returns the files dropped
+    QStringList removeDirectory(const QString& dir);
+    // Moves the directory's entries to the new name; returns (old, new) per file
+    QList<QPair<QString, QString>> renameDirectory(const QString& from, const QString& to);
+
+private:
+    QString m_file;
+    QString m_root;
+    bool m_recursive;
+    QHash<QString, LibraryEntry> m_entries;
+    QSet<QString> m_directories;
+    bool m_dirty;
+};
+
+#endif // LIBRARYINDEX_H
@@ -0,0 +1,339 @@
+#include "LibraryWatcher.h"
+#include "DirectoryScanner.h"
+#include <QTimer>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+
+#ifdef Q_OS_LINUX
+#include "SocketNotifier.h"
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#else
+#include <QFileSystemWatcher>
+#endif
+
+namespace {
+// Long enough that a copied album arrives as one batch, short enough to feel live
+const int kFlushDelayMs = 250;
+
+bool isUnder(const QString& path, const QString& dir) {
+    return path.size() > dir.size() && path.startsWith(dir) && path.at(dir.size()) == '/';
+}
+
+QString reparent(const QString& path, const QString& from, const QString& to) {
+    return to + path.mid(from.size());
+}
+
+#ifdef Q_OS_LINUX
+const uint32_t kWatchMask = IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM |
+                            IN_MOVED_TO | IN_ONLYDIR;
+#else
+// Image file names plus subdirectory names with a trailing '/'
+QSet<QString> listDirectory(const QString& dir) {
+    QSet<QString> names;
+    QDirIterator it(dir, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+    while (it.hasNext()) {
+        it.next();
+        QFileInfo info = it.fileInfo();
+        if (info.isDir()) {
+            if (!info.isSymLink()) names.insert(info.fileName() + '/');
+        } else if (DirectoryScanner::isImageFile(info.fileName())) {
+            names.insert(info.fileName());
+        }
+    }
+    return names;
+}
+#endif
+}
+
+LibraryWatcher::LibraryWatcher(QObject* parent)
+    : QObject(parent), m_recursive(false)
+{
+    m_flushTimer = new QTimer(this);
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(kFlushDelayMs);
+    connect(m_flushTimer, &QTimer::timeout, this, &LibraryWatcher::flush);
+
+#ifdef Q_OS_LINUX
+    m_fd = -1;
+    m_notifier = nullptr;
+#else
+    m_fsWatcher = new QFileSystemWatcher(this);
+    connect(m_fsWatcher, &QFileSystemWatcher::directoryChanged, this, &LibraryWatcher::onDirectoryChanged);
+#endif
+}
+
+LibraryWatcher::~LibraryWatcher() {
+    stop();
+}
+
+void LibraryWatcher::start(const QString& root, bool recursive) {
+    stop();
+    m_root = root;
+    m_recursive = recursive;
+
+#ifdef Q_OS_LINUX
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0) {
+        qWarning() << "inotify unavailable, library changes won't be picked up:" << strerror(errno);
+        return;
+    }
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+    connect(m_notifier, SocketNotifier::activated(), this, &LibraryWatcher::readEvents);
+#endif
+
+    addWatch(root);
+}
+
+void LibraryWatcher::stop() {
+    m_flushTimer->stop();
+    m_pending.clear();
+    m_root.clear();
+
+#ifdef Q_OS_LINUX
+    delete m_notifier;
+    m_notifier = nullptr;
+    if (m_fd >= 0) ::close(m_fd); // Drops every watch with it
+    m_fd = -1;
+    m_wdToDir.clear();
+    m_dirToWd.clear();
+#else
+    if (!m_listing.isEmpty()) m_fsWatcher->removePaths(m_listing.keys());
+    m_listing.clear();
+#endif
+}
+
+void LibraryWatcher::watchDirectories(const QStringList& dirs) {
+    if (m_root.isEmpty() || !m_recursive) return;
+    for (const QString& dir : dirs) {
+        if (dir == m_root || isUnder(dir, m_root)) addWatch(dir);
+    }
+}
+
+void LibraryWatcher::addWatch(const QString& dir) {
+#ifdef Q_OS_LINUX
+    if (m_fd < 0 || m_dirToWd.contains(dir)) return;
+    int wd = inotify_add_watch(m_fd, QFile::encodeName(dir).constData(), kWatchMask);
+    if (wd < 0) {
+        static bool warned = false;
+        if (!warned) {
+            warned = true;
+            qWarning() << "Could not watch" << dir << ":" << strerror(errno)
+                       << "(raise fs.inotify.max_user_watches for big libraries)";
+        }
+        return;
+    }
+    m_wdToDir.insert(wd, dir);
+    m_dirToWd.insert(dir, wd);
+#else
+    if (m_listing.contains(dir)) return;
+    m_fsWatcher->addPath(dir);
+    m_listing.insert(dir, listDirectory(dir));
+#endif
+}
+
+void LibraryWatcher::removeWatchesUnder(const QString& dir) {
+#ifdef Q_OS_LINUX
+    for (auto it = m_dirToWd.begin(); it != m_dirToWd.end(); ) {
+        if (it.key() == dir || isUnder(it.key(), dir)) {
+            inotify_rm_watch(m_fd, it.value());
+            m_wdToDir.remove(it.value());
+            it = m_dirToWd.erase(it);
+        } else {
+            ++it;
+        }
+    }
+#else
+    for (auto it = m_listing.begin(); it != m_listing.end(); ) {
+        if (it.key() == dir || isUnder(it.key(), dir)) {
+            m_fsWatcher->removePath(it.key());
+            it = m_listing.erase(it);
+        } else {
+            ++it;
+        }
+    }
+#endif
+}
+
+void LibraryWatcher::renameWatchesUnder(const QString& from, const QString& to) {
+#ifdef Q_OS_LINUX
+    // Watches follow the inode, only our names for them change
+    QHash<QString, int> moved;
+    for (auto it = m_dirToWd.begin(); it != m_dirToWd.end(); ) {
+        if (it.key() == from || isUnder(it.key(), from)) {
+            moved.insert(reparent(it.key(), from, to), it.value());
+            it = m_dirToWd.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = moved.constBegin(); it != moved.constEnd(); ++it) {
+        m_dirToWd.insert(it.key(), it.value());
+        m_wdToDir.insert(it.value(), it.key());
+    }
+#else
+    removeWatchesUnder(from);
+    QStringList dirs;
+    dirs << to;
+    QDirIterator it(to, QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while (it.hasNext()) dirs << it.next();
+    for (const QString& dir : dirs) addWatch(dir);
+#endif
+}
+
+void LibraryWatcher::directoryAppeared(const QString& dir) {
+    if (!m_recursive) return;
+
+    // Watch first, then list, so nothing lands in between unseen. A file
+    // may be reported twice (listing and event); adding is idempotent.
+    addWatch(dir);
+    QDirIterator it(dir, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        QString path = it.next();
+        QFileInfo info = it.fileInfo();
+        if (info.isDir()) {
+            if (!info.isSymLink()) addWatch(path);
+        } else if (DirectoryScanner::isImageFile(info.fileName())) {
+            note(LibraryChange::Added, path);
+        }
+    }
+}
+
+void LibraryWatcher::readEvents() {
+#ifdef Q_OS_LINUX
+    alignas(struct inotify_event) char buf[64 * 1024];
+    QHash<quint32, QPair<QString, bool>> movedFrom; // Cookie -> path, is dir
+    bool overflow = false;
+
+    forever {
+        ssize_t n = ::read(m_fd, buf, sizeof(buf));
+        if (n <= 0) break; // EAGAIN: drained
+
+        for (char* p = buf; p < buf + n; ) {
+            const struct inotify_event* ev = reinterpret_cast<const struct inotify_event*>(p);
+            p += sizeof(struct inotify_event) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW) {
+                overflow = true;
+                continue;
+            }
+            if (ev->mask & IN_IGNORED) {
+                // Watched directory is gone
+                QString dir = m_wdToDir.take(ev->wd);
+                if (!dir.isEmpty()) m_dirToWd.remove(dir);
+                continue;
+            }
+
+            QString dir = m_wdToDir.value(ev->wd);
+            if (dir.isEmpty() || ev->len == 0) continue;
+
+            QString name = QFile::decodeName(ev->name);
+            QString path = dir + '/' + name;
+            bool isDir = ev->mask & IN_ISDIR;
+            bool isImage = !isDir && DirectoryScanner::isImageFile(name);
+            if (isDir && !m_recursive) continue;
+
+            if (ev->mask & IN_MOVED_FROM) {
+                if (isDir || isImage) movedFrom.insert(ev->cookie, qMakePair(path, isDir));
+            } else if (ev->mask & IN_MOVED_TO) {
+                auto it = movedFrom.find(ev->cookie);
+                if (it != movedFrom.end()) {
+                    QString from = it->first;
+                    movedFrom.erase(it);
+                    if (isDir) {
+                        renameWatchesUnder(from, path);
+                        note(LibraryChange::RenamedDir, from, path);
+                    } else if (isImage) {
+                        note(LibraryChange::Renamed, from, path);
+                    } else {
+                        note(LibraryChange::Removed, from); // Renamed to something that isn't an image
+                    }
+                } else if (isDir) {
+                    directoryAppeared(path); // Moved in from outside the library
+                } else if (isImage) {
+                    note(LibraryChange::Added, path);
+                }
+            } else if (ev->mask & IN_CREATE) {
+                // Files are reported once written (IN_CLOSE_WRITE)
+                if (isDir) directoryAppeared(path);
+            } else if (ev->mask & IN_CLOSE_WRITE) {
+                if (isImage) note(LibraryChange::Added, path);
+            } else if (ev->mask & IN_DELETE) {
+                if (isDir) {
+                    removeWatchesUnder(path);
+                    note(LibraryChange::RemovedDir, path);
+                } else if (isImage) {
+                    note(LibraryChange::Removed, path);
+                }
+            }
+        }
+    }
+
+    // No partner: moved out of the library
+    for (auto it = movedFrom.constBegin(); it != movedFrom.constEnd(); ++it) {
+        if (it->second) {
+            removeWatchesUnder(it->first);
+            note(LibraryChange::RemovedDir, it->first);
+        } else {
+            note(LibraryChange::Removed, it->first);
+        }
+    }
+
+    if (overflow) {
+        qWarning() << "inotify queue overflowed, library needs a rescan";
+        emit overflowed();
+    }
+#endif
+}
+
+void LibraryWatcher::onDirectoryChanged(const QString& dir) {
+#ifndef Q_OS_LINUX
+    auto known = m_listing.find(dir);
+    if (known == m_listing.end()) return;
+
+    if (!QFileInfo(dir).isDir()) {
+        removeWatchesUnder(dir);
+        if (dir != m_root) note(LibraryChange::RemovedDir, dir);
+        return;
+    }
+
+    QSet<QString> now = listDirectory(dir);
+    QSet<QString> before = known.value();
+    known.value() = now;
+
+    for (const QString& name : before) {
+        if (now.contains(name)) continue;
+        if (name.endsWith('/')) {
+            QString sub = dir + '/' + name.left(name.size() - 1);
+            removeWatchesUnder(sub);
+            note(LibraryChange::RemovedDir, sub);
+        } else {
+            note(LibraryChange::Removed, dir + '/' + name);
+        }
+    }
+    for (const QString& name : now) {
+        if (before.contains(name)) continue;
+        if (name.endsWith('/')) directoryAppeared(dir + '/' + name.left(name.size() - 1));
+        else note(LibraryChange::Added, dir + '/' + name);
+    }
+#else
+    Q_UNUSED(dir);
+#endif
+}
+
+void LibraryWatcher::note(LibraryChange::Kind kind, const QString& path, const QString& newPath) {
+    m_pending.append({kind, path, newPath});
+    if (!m_flushTimer->isActive()) m_flushTimer->start();
+}
+
+void LibraryWatcher::flush() {
+    if (m_pending.isEmpty()) return;
+    QVector<LibraryChange> changes;
+    changes.swap(m_pending);
+    emit changed(changes);
+}
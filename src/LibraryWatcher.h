@@ -0,0 +1,80 @@
+#ifndef LIBRARYWATCHER_H
+#define LIBRARYWATCHER_H
+
+#include <QObject>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+
+class QTimer;
+class QSocketNotifier;
+class QFileSystemWatcher;
+
+// One filesystem change below the library root. Batches are delivered in
+// the order things happened, so applying them one by one is always right.
+struct LibraryChange {
+    enum Kind {
+        Added,      // New or rewritten image file
+        Removed,    // Image file
+        Renamed,    // Image file, path -> newPath
+        RemovedDir, // Everything below path is gone
+        RenamedDir  // Directory, path -> newPath
+    };
+    Kind kind;
+    QString path;
+    QString newPath;
+};
+
+// Watches the library tree and reports changes in batches, so the library
+// never needs a full rescan while the app is up. Uses inotify on Linux
+// (one watch per directory, renames paired by cookie); elsewhere falls back
+// to QFileSystemWatcher and diffs directory listings, where a rename shows
+// up as a delete plus an add and files rewritten in place go unnoticed.
+class LibraryWatcher : public QObject {
+    Q_OBJECT
+public:
+    explicit LibraryWatcher(QObject* parent = nullptr);
+    ~LibraryWatcher();
+
+    // Watches root; subdirectories are added with watchDirectories()
+    void start(const QString& root, bool recursive);
+    void stop();
+    void watchDirectories(const QStringList& dirs);
+
+signals:
+    void changed(QVector<LibraryChange> changes);
+    // Events were lost (kernel queue overflow); the caller should rescan
+    void overflowed();
+
+private slots:
+    void flush();
+    void readEvents();                           // inotify
+    void onDirectoryChanged(const QString& dir); // QFileSystemWatcher fallback
+
+private:
+    void addWatch(const QString& dir);
+    void removeWatchesUnder(const QString& dir);
+    void renameWatchesUnder(const QString& from, const QString& to);
+    // A directory was created or moved in: watch it and report its images
+    void directoryAppeared(const QString& dir);
+
+    void note(LibraryChange::Kind kind, const QString& path, const QString& newPath = QString());
+
+    QString m_root;
+    bool m_recursive;
+    QVector<LibraryChange> m_pending;
+    QTimer* m_flushTimer;
+
+#ifdef Q_OS_LINUX
+    int m_fd;
+    QSocketNotifier* m_notifier;
+    QHash<int, QString> m_wdToDir;
+    QHash<QString, int> m_dirToWd;
+#else
+    QFileSystemWatcher* m_fsWatcher;
+    QHash<QString, QSet<QString>> m_listing; // Dir -> image file names and "/"-suffixed subdir names
+#endif
+};
+
+#endif // LIBRARYWATCHER_H
@@ -4,15 +4,17 @@
 #include <QMessageBox>
 #include <QResizeEvent>
 #include <QCloseEvent>
-#include <QDirIterator>
+#include <QDir>
+#include <QFileInfo>
 #include <QKeyEvent>
 #include <QDateTime>
-#include <QPainter>
+#include <QScrollBar>
 #include <algorithm> // for std::shuffle
+#include <iterator>  // for std::back_inserter
 #include <random>    // for std::default_random_engine
 
 MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent), m_currentPage(0), m_totalPages(0), m_thumbsPerPage(20),
+    : QMainWindow(parent), m_reconciling(false), m_visibleFirst(0), m_visibleLast(-1),
       m_controlsVisible(true)
 {
     // Window Setup
@@ -21,18 +23,36 @@ MainWindow::MainWindow(QWidget *parent)
                   
     // Threading Setup
     m_thumbThread = new QThread(this);
+    m_thumbThread->setObjectName("thumbnails"); // Thread name in traces
     m_thumbLoader = new ThumbnailLoader();
     m_thumbLoader->moveToThread(m_thumbThread);
     
     connect(m_thumbThread, &QThread::started, m_thumbLoader, &ThumbnailLoader::process);
-    connect(m_thumbLoader, &ThumbnailLoader::thumbnailReady, this, &MainWindow::onThumbnailReady);
+    connect(m_thumbLoader, &ThumbnailLoader::thumbnailsReady, this, &MainWindow::onThumbnailsReady);
     connect(m_thumbLoader, &ThumbnailLoader::cacheCleared, this, [this](){
         QMessageBox::information(this, "Cache Cleared", "Thumbnail cache has been cleared.");
-        populateThumbnails();
+        // Library itself is unchanged; just have every icon generated again
+        m_thumbModel->clearIcons();
+        m_thumbLoader->setPaths(m_displayImagePaths);
     });
     
     m_thumbThread->start();
 
+    m_scanner = new DirectoryScanner(this);
+    connect(m_scanner, &DirectoryScanner::filesFound, this, &MainWindow::onFilesFound);
+    connect(m_scanner, &DirectoryScanner::directoriesFound, this, &MainWindow::onDirectoriesFound);
+    connect(m_scanner, &DirectoryScanner::progress, this, &MainWindow::onScanProgress);
+    connect(m_scanner, &DirectoryScanner::finished, this, &MainWindow::onScanFinished);
+    
+    m_watcher = new LibraryWatcher(this);
+    connect(m_watcher, &LibraryWatcher::changed, this, &MainWindow::onLibraryChanged);
+    connect(m_watcher, &LibraryWatcher::overflowed, this, &MainWindow::rescanLibrary);
+    
+    m_librarySaveTimer = new QTimer(this);
+    m_librarySaveTimer->setSingleShot(true);
+    m_librarySaveTimer->setInterval(2000);
+    connect(m_librarySaveTimer, &QTimer::timeout, this, &MainWindow::saveLibraryIndex);
+
     setupUi();
     
     // Load config
@@ -58,6 +78,7 @@ MainWindow::MainWindow(QWidget *parent)
 }
 
 MainWindow::~MainWindow() {
+    saveLibraryIndex();
     m_thumbLoader->stop();
     m_thumbThread->quit();
     m_thumbThread->wait();
@@ -145,29 +166,31 @@ void MainWindow::setupUi() {
     m_mainLayout->addWidget(m_lblCachePath);
     
     // Thumbnails
-    m_listWidget = new QListWidget();
-    m_listWidget->setViewMode(QListWidget::IconMode);
-    m_listWidget->setIconSize(QSize(150, 150));
-    m_listWidget->setResizeMode(QListWidget::Adjust);
-    m_listWidget->setGridSize(QSize(170, 200)); // Spacing
-    m_listWidget->setSpacing(5);
-    m_listWidget->setStyleSheet("QListWidget::item { color: #ccc; } QListWidget::item:selected { background-color: #444; }");
-    m_mainLayout->addWidget(m_listWidget);
-    
-    // Pagination
-    m_paginationFrame = new QWidget();
-    QHBoxLayout* pageLayout = new QHBoxLayout(m_paginationFrame);
-    m_btnPrevPage = new QPushButton("< Prev");
-    m_lblPage = new QLabel("Page 0/0");
-    m_btnNextPage = new QPushButton("Next >");
-    
-    pageLayout->addStretch();
-    pageLayout->addWidget(m_btnPrevPage);
-    pageLayout->addWidget(m_lblPage);
-    pageLayout->addWidget(m_btnNextPage);
-    pageLayout->addStretch();
-    
-    m_mainLayout->addWidget(m_paginationFrame);
+    m_thumbModel = new ThumbnailModel(this);
+    m_thumbDelegate = new ThumbnailDelegate(this);
+    
+    // List mode wrapping left-to-right rather than IconMode: IconMode keeps
+    // per-item geometry, list mode with uniform sizes is pure arithmetic
+    m_gridView = new QListView();
+    m_gridView->setFlow(QListView::LeftToRight);
+    m_gridView->setWrapping(true);
+    m_gridView->setMovement(QListView::Static);
+    m_gridView->setResizeMode(QListView::Adjust);
+    m_gridView->setUniformItemSizes(true);
+    m_gridView->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+    m_gridView->setIconSize(QSize(150, 150));
+    m_gridView->setGridSize(QSize(170, 200)); // Spacing
+    m_gridView->setModel(m_thumbModel);
+    m_gridView->setItemDelegate(m_thumbDelegate);
+    m_mainLayout->addWidget(m_gridView);
+    
+    m_lblCount = new QLabel("0 images");
+    m_lblCount->setAlignment(Qt::AlignCenter);
+    m_mainLayout->addWidget(m_lblCount);
+    
+    m_visibleRangeTimer = new QTimer(this);
+    m_visibleRangeTimer->setSingleShot(true);
+    m_visibleRangeTimer->setInterval(30);
     
     m_stackedWidget->addWidget(m_gridPage);
     
@@ -183,25 +206,24 @@ void MainWindow::setupConnections() {
     connect(m_btnQuit, &QPushButton::clicked, this, &MainWindow::quitApplication);
     connect(m_btnClearCache, &QPushButton::clicked, this, &MainWindow::clearCache);
     
-    connect(m_btnNextPage, &QPushButton::clicked, this, &MainWindow::nextPage);
-    connect(m_btnPrevPage, &QPushButton::clicked, this, &MainWindow::prevPage);
-    
     connect(m_chkRecursive, &QCheckBox::stateChanged, this, &MainWindow::saveSettings);
-    connect(m_chkRandom, &QCheckBox::stateChanged, [this](int){ saveSettings(); populateThumbnails(); });
+    connect(m_chkRandom, &QCheckBox::stateChanged, this, &MainWindow::onRandomOrderToggled);
     connect(m_chkLoop, &QCheckBox::stateChanged, this, &MainWindow::saveSettings);
     
     connect(m_txtDuration, &QLineEdit::editingFinished, this, &MainWindow::saveSettings);
     connect(m_txtTransition, &QLineEdit::editingFinished, this, &MainWindow::saveSettings);
     connect(m_txtCacheSize, &QLineEdit::editingFinished, this, &MainWindow::saveSettings);
     
-    connect(m_listWidget, &QListWidget::itemClicked, this, &MainWindow::onThumbnailClicked);
+    connect(m_gridView, &QListView::clicked, this, &MainWindow::onThumbnailClicked);
     
-    connect(m_sliderZoom, &QSlider::valueChanged, [this](int value){
-         m_listWidget->setIconSize(QSize(value, value));
-         m_listWidget->setGridSize(QSize(value + 20, value + 50)); // More vertical space for text
-         calculatePagination();
-         displayCurrentPage();
-    });
+    connect(m_sliderZoom, &QSlider::valueChanged, this, &MainWindow::applyZoom);
+    
+    // Loader priority follows the viewport directly
+    connect(m_visibleRangeTimer, &QTimer::timeout, this, &MainWindow::updateVisibleRange);
+    connect(m_gridView->verticalScrollBar(), &QScrollBar::valueChanged,
+            m_visibleRangeTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
+    connect(m_thumbModel, &QAbstractItemModel::modelReset,
+            m_visibleRangeTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
 }
 
 void MainWindow::selectFolder() {
@@ -217,145 +239,340 @@ void MainWindow::selectFolder() {
 }
 
 void MainWindow::populateThumbnails() {
-    m_listWidget->clear();
+    saveLibraryIndex(); // Before cancelling: a partial first scan is not saved
+    m_scanner->cancel();
+    m_watcher->stop();
+    m_reconciling = false;
+    m_scanned.clear();
+    m_scannedDirs.clear();
     m_allImagePaths.clear();
+    m_displayImagePaths.clear();
+    m_thumbModel->setPaths(QStringList());
+    m_thumbLoader->setIconSize(m_gridView->iconSize(), devicePixelRatioF());
+    m_thumbLoader->setPaths(QStringList());
+    m_gridView->scrollToTop();
     
     QString folder = ConfigManager::instance().lastFolder();
     bool recursive = ConfigManager::instance().recursive();
     
-    if (folder.isEmpty() || !QDir(folder).exists()) return;
+    if (folder.isEmpty() || !QDir(folder).exists()) {
+        m_slideshowPage->setImagePaths(QStringList());
+        m_lblCount->setText("0 images");
+        return;
+    }
     
-    // Collect images
-    QStringList exts = {"*.png", "*.jpg", "*.jpeg", "*.bmp", "*.gif"};
-    QDirIterator it(folder, exts, QDir::Files, 
-                   recursive ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags);
-                   
-    while (it.hasNext()) {
-        m_allImagePaths << it.next();
+    // Watch before listing anything so no change falls in between
+    m_watcher->start(folder, recursive);
+    
+    if (m_library.load(folder, recursive)) {
+        // Known library: show it right away, catch up in the background
+        m_allImagePaths = m_library.paths();
+        orderPaths(m_allImagePaths);
+        m_displayImagePaths = m_allImagePaths;
+        m_slideshowPage->setImagePaths(m_displayImagePaths);
+        m_thumbModel->setPaths(m_displayImagePaths);
+        m_thumbLoader->setPaths(m_displayImagePaths);
+        m_lblCount->setText(QString("%1 images").arg(m_displayImagePaths.size()));
+        
+        m_watcher->watchDirectories(m_library.directories());
+        rescanLibrary();
+        return;
     }
     
-    // Sort or Shuffle
+    // First visit: results stream in from the scanner; the grid fills as they arrive
+    m_library.reset(folder, recursive);
+    m_lblCount->setText("Scanning...");
+    m_scanner->start(folder, recursive);
+}
+
+void MainWindow::rescanLibrary() {
+    if (m_scanner->isRunning() || m_library.root().isEmpty()) return;
+    m_reconciling = true;
+    m_scanned.clear();
+    m_scannedDirs.clear();
+    m_scanner->start(m_library.root(), m_library.recursive());
+}
+
+void MainWindow::orderPaths(QStringList& paths) const {
     if (ConfigManager::instance().randomOrder()) {
         auto rng = std::default_random_engine(QDateTime::currentMSecsSinceEpoch());
-        std::shuffle(m_allImagePaths.begin(), m_allImagePaths.end(), rng);
+        std::shuffle(paths.begin(), paths.end(), rng);
     } else {
-        m_allImagePaths.sort();
+        paths.sort();
     }
-    
-    m_displayImagePaths = m_allImagePaths;
-    m_slideshowPage->setImagePaths(m_displayImagePaths);
-    
-    // Reset pagination
-    m_currentPage = 0;
-    calculatePagination();
-    displayCurrentPage();
 }
 
-void MainWindow::calculatePagination() {
-    int w = m_listWidget->width();
-    int h = m_listWidget->height();
-    if (w < 100) w = 800; // default if not shown yet
-    if (h < 100) h = 600;
-    
-    
-    // Estimation
-    int itemW = m_listWidget->gridSize().width();
-    int itemH = m_listWidget->gridSize().height();
-    if (itemW <= 0) itemW = 170; // fallback
-    if (itemH <= 0) itemH = 180;
+void MainWindow::onFilesFound(QVector<ScannedFile> files) {
+    if (m_reconciling) {
+        // The index is already on screen; just collect for the diff
+        for (const ScannedFile& file : files) {
+            m_scanned.insert(file.path, {file.size, file.lastModified});
+        }
+        return;
+    }
     
-    m_cols = qMax(1, w / itemW);
-    m_rows = qMax(1, h / itemH);
-    m_thumbsPerPage = m_cols * m_rows;
+    QStringList paths;
+    paths.reserve(files.size());
+    for (const ScannedFile& file : files) {
+        if (m_library.contains(file.path)) continue; // The watcher got there first
+        m_library.insert(file.path, {file.size, file.lastModified});
+        paths << file.path;
+    }
+    if (paths.isEmpty()) return;
     
-    if (m_displayImagePaths.isEmpty()) {
-        m_totalPages = 0;
+    // Straight into their final place, so the finished scan needn't reorder
+    // (and reset) the grid under the user
+    insertOrdered(m_allImagePaths, paths);
+    m_displayImagePaths = m_allImagePaths;
+    m_thumbModel->insertPaths(m_displayImagePaths);
+    m_thumbLoader->updatePaths(m_displayImagePaths);
+    m_visibleRangeTimer->start();
+}
+
+void MainWindow::onDirectoriesFound(QStringList directories) {
+    m_watcher->watchDirectories(directories);
+    if (m_reconciling) {
+        m_scannedDirs << directories;
     } else {
-        m_totalPages = (m_displayImagePaths.size() + m_thumbsPerPage - 1) / m_thumbsPerPage;
+        for (const QString& dir : directories) m_library.addDirectory(dir);
     }
 }
 
-void MainWindow::displayCurrentPage() {
-    m_listWidget->clear();
-    
-    if (m_displayImagePaths.isEmpty()) {
-        m_lblPage->setText("Page 0/0");
+void MainWindow::onScanProgress(int files, int directories) {
+    if (m_reconciling) return; // Quiet catch-up, the count is already right
+    m_lblCount->setText(QString("Scanning... %1 images (%2 folders)").arg(files).arg(directories));
+}
+
+void MainWindow::onScanFinished() {
+    if (m_reconciling) {
+        // Whatever changed while we weren't running, as if the watcher had seen it
+        QVector<LibraryChange> changes;
+        const QHash<QString, LibraryEntry>& known = m_library.entries();
+        for (auto it = known.constBegin(); it != known.constEnd(); ++it) {
+            if (!m_scanned.contains(it.key())) changes.append({LibraryChange::Removed, it.key(), QString()});
+        }
+        for (auto it = m_scanned.constBegin(); it != m_scanned.constEnd(); ++it) {
+            auto old = known.constFind(it.key());
+            if (old == known.constEnd() || old->size != it->size || old->lastModified != it->lastModified) {
+                changes.append({LibraryChange::Added, it.key(), QString()});
+            }
+        }
+        m_library.setDirectories(m_scannedDirs);
+        m_reconciling = false;
+        m_scanned.clear();
+        m_scannedDirs.clear();
+        if (!changes.isEmpty()) onLibraryChanged(changes);
+        m_librarySaveTimer->start();
         return;
     }
     
-    // Ensure bounds
-    if (m_currentPage >= m_totalPages) m_currentPage = m_totalPages - 1;
-    if (m_currentPage < 0) m_currentPage = 0;
+    // The grid and the loader already have every row, in order
+    m_slideshowPage->setImagePaths(m_displayImagePaths);
+    m_lblCount->setText(QString("%1 images").arg(m_displayImagePaths.size()));
+    saveLibraryIndex();
+}
+
+void MainWindow::onLibraryChanged(QVector<LibraryChange> changes) {
+    QHash<QString, QString> renamedTo; // Path before this batch -> path now
+    QHash<QString, QString> originOf;  // Path now -> path before this batch
+    QSet<QString> touched;             // Paths that may be new to the list
+    QStringList invalidated;           // Thumbnails to drop: deleted or rewritten
+    QList<QPair<QString, QString>> renamedFiles;
+    
+    auto rename = [&](const QString& from, const QString& to) {
+        QString origin = originOf.take(from);
+        if (origin.isEmpty()) origin = from;
+        renamedTo.insert(origin, to);
+        originOf.insert(to, origin);
+        renamedFiles << qMakePair(from, to);
+        touched.insert(to);
+    };
+    auto add = [&](const QString& path) {
+        QFileInfo fi(path);
+        if (!fi.isFile()) return; // Gone again already
+        LibraryEntry entry = {fi.size(), fi.lastModified().toMSecsSinceEpoch()};
+        auto old = m_library.entries().constFind(path);
+        if (old != m_library.entries().constEnd() &&
+            (old->size != entry.size || old->lastModified != entry.lastModified)) {
+            invalidated << path;
+        }
+        m_library.insert(path, entry);
+        touched.insert(path);
+    };
+    
+    // In order: the watcher reports events as they happened
+    for (const LibraryChange& change : changes) {
+        switch (change.kind) {
+        case LibraryChange::Added:
+            add(change.path);
+            break;
+        case LibraryChange::Removed:
+            // Recreated since (or never known): nothing to drop
+            if (!m_library.contains(change.path) || QFileInfo::exists(change.path)) break;
+            m_library.remove(change.path);
+            invalidated << change.path;
+            break;
+        case LibraryChange::Renamed:
+            if (!m_library.contains(change.path)) {
+                add(change.newPath);
+                break;
+            }
+            m_library.insert(change.newPath, m_library.entries().value(change.path));
+            m_library.remove(change.path);
+            rename(change.path, change.newPath);
+            break;
+        case LibraryChange::RemovedDir:
+            invalidated << m_library.removeDirectory(change.path);
+            break;
+        case LibraryChange::RenamedDir:
+            for (const auto& moved : m_library.renameDirectory(change.path, change.newPath)) {
+                rename(moved.first, moved.second);
+            }
+            break;
+        }
+    }
+    
+    // Survivors keep their place (under their new name); new files go in
+    // at their sorted spot, or anywhere when shuffled
+    QStringList paths;
+    QSet<QString> seen;
+    paths.reserve(m_displayImagePaths.size() + touched.size());
+    for (const QString& old : m_displayImagePaths) {
+        QString path = renamedTo.value(old, old);
+        if (!m_library.contains(path) || seen.contains(path)) continue;
+        paths << path;
+        seen.insert(path);
+    }
+    QStringList added;
+    for (const QString& path : touched) {
+        if (m_library.contains(path) && !seen.contains(path)) added << path;
+    }
     
-    m_lblPage->setText(QString("Page %1/%2").arg(m_currentPage + 1).arg(m_totalPages));
+    if (!ConfigManager::instance().randomOrder()) paths.sort(); // Renamed files may have moved
+    insertOrdered(paths, added);
     
-    int startIdx = m_currentPage * m_thumbsPerPage;
-    int endIdx = qMin(startIdx + m_thumbsPerPage, m_displayImagePaths.size());
+    m_thumbLoader->renamePaths(renamedFiles);
+    m_thumbLoader->invalidatePaths(invalidated);
     
-    // Prepare items with placeholders
-    for (int i = startIdx; i < endIdx; ++i) {
-        QString path = m_displayImagePaths[i];
-        QListWidgetItem* item = new QListWidgetItem();
-        item->setText(QFileInfo(path).fileName());
-        // item->setData(Qt::UserRole, path); // Store path
-        item->setData(Qt::UserRole, i); // Store global index
+    if (paths != m_displayImagePaths) {
+        m_allImagePaths = paths;
+        m_displayImagePaths = paths;
         
-        // Placeholder icon?
-        QSize iconSize = m_listWidget->iconSize();
-        QPixmap placeholder(iconSize);
-        placeholder.fill(Qt::black);
-        item->setIcon(QIcon(placeholder));
+        int scroll = m_gridView->verticalScrollBar()->value();
+        m_thumbModel->updatePaths(m_displayImagePaths);
+        m_gridView->verticalScrollBar()->setValue(scroll);
+        m_thumbLoader->updatePaths(m_displayImagePaths);
+        m_slideshowPage->updateImagePaths(m_displayImagePaths, renamedTo);
         
-        m_listWidget->addItem(item);
+        if (!m_scanner->isRunning() || m_reconciling) {
+            m_lblCount->setText(QString("%1 images").arg(m_displayImagePaths.size()));
+        }
     }
     
-    // Update thread priority
-    QStringList pagePaths;
-    for (int i = startIdx; i < endIdx; ++i) pagePaths << m_displayImagePaths[i];
-    
-    m_thumbLoader->setPaths(m_displayImagePaths); // Send all, but...
-    m_thumbLoader->updatePriority(m_currentPage, m_thumbsPerPage);
+    m_librarySaveTimer->start();
 }
 
-void MainWindow::onThumbnailReady(int index, QString path, QImage image) {
-    // Check if this index is on current page
-    int startIdx = m_currentPage * m_thumbsPerPage;
-    int endIdx = startIdx + m_thumbsPerPage;
-    
-    if (index >= startIdx && index < endIdx) {
-        int localRow = index - startIdx;
-        if (localRow < m_listWidget->count()) {
-            QListWidgetItem* item = m_listWidget->item(localRow);
-            if (item) {
-                // Determine layout size
-                QSize iconSize = m_listWidget->iconSize();
-                QPixmap canvas(iconSize);
-                canvas.fill(Qt::transparent);
-                
-                // Draw centered
-                QPainter p(&canvas);
-                QPixmap thumb = QPixmap::fromImage(image);
-                int x = (iconSize.width() - thumb.width()) / 2;
-                int y = (iconSize.height() - thumb.height()) / 2;
-                p.drawPixmap(x, y, thumb);
-                p.end();
-
-                item->setIcon(QIcon(canvas));
-            }
+void MainWindow::onRandomOrderToggled() {
+    saveSettings();
+    // Same files, new order: no need to touch the disk
+    orderPaths(m_allImagePaths);
+    m_displayImagePaths = m_allImagePaths;
+    m_slideshowPage->setImagePaths(m_displayImagePaths);
+    m_thumbModel->setPaths(m_displayImagePaths);
+    m_gridView->scrollToTop();
+    m_thumbLoader->setPaths(m_displayImagePaths);
+}
+
+void MainWindow::insertOrdered(QStringList& paths, QStringList added) const {
+    if (added.isEmpty()) return;
+    QStringList merged;
+    merged.reserve(paths.size() + added.size());
+    if (ConfigManager::instance().randomOrder()) {
+        // Random slots, merged in one pass
+        auto rng = std::default_random_engine(QDateTime::currentMSecsSinceEpoch());
+        std::shuffle(added.begin(), added.end(), rng);
+        std::uniform_int_distribution<int> slot(0, paths.size());
+        QVector<int> slots;
+        for (int i = 0; i < added.size(); ++i) slots << slot(rng);
+        std::sort(slots.begin(), slots.end());
+        
+        int next = 0;
+        for (int i = 0; i <= paths.size(); ++i) {
+            while (next < slots.size() && slots[next] == i) merged << added[next++];
+            if (i < paths.size()) merged << paths[i];
         }
+    } else {
+        added.sort();
+        std::merge(paths.begin(), paths.end(), added.begin(), added.end(), std::back_inserter(merged));
+    }
+    paths = merged;
+}
+
+void MainWindow::saveLibraryIndex() {
+    m_librarySaveTimer->stop();
+    // A half-finished first scan isn't worth keeping
+    if (m_scanner->isRunning() && !m_reconciling) return;
+    if (m_library.isDirty() && !m_library.root().isEmpty()) m_library.save();
+}
+
+void MainWindow::applyZoom(int value) {
+    m_gridView->setIconSize(QSize(value, value));
+    m_gridView->setGridSize(QSize(value + 20, value + 50)); // More vertical space for text
+    
+    // Icons were composed for the old size; the loader re-serves the new one
+    m_thumbModel->clearIcons();
+    m_thumbLoader->setIconSize(m_gridView->iconSize(), devicePixelRatioF());
+    m_visibleRangeTimer->start();
+}
+
+void MainWindow::updateVisibleRange() {
+    int count = m_thumbModel->rowCount();
+    if (count == 0) return;
+    
+    // Uniform grid: derive the range from the first cell's position and the
+    // cell pitch instead of probing items
+    QRect first = m_gridView->visualRect(m_thumbModel->index(0));
+    QSize cell = m_gridView->gridSize();
+    if (!first.isValid() || cell.isEmpty()) return;
+    
+    QRect viewport = m_gridView->viewport()->rect();
+    int cols = qMax(1, viewport.width() / cell.width());
+    int firstLine = qMax(0, (viewport.top() - first.top()) / cell.height());
+    int lastLine = qMax(0, (viewport.bottom() - first.top()) / cell.height());
+    int visibleRows = lastLine - firstLine + 1;
+    
+    // One screen of prefetch either way so scrolling reveals finished icons
+    int firstRow = qMax(0, firstLine - visibleRows) * cols;
+    int lastRow = qMin(count - 1, (lastLine + visibleRows + 1) * cols - 1);
+    if (firstRow == m_visibleFirst && lastRow == m_visibleLast) return;
+    m_visibleFirst = firstRow;
+    m_visibleLast = lastRow;
+    
+    m_thumbLoader->setVisibleRange(firstRow, lastRow);
+    
+    // Keep icons for a few screens around the viewport; the loader re-serves
+    // anything dropped once it scrolls back in
+    int keep = (lastRow - firstRow + 1) * 2;
+    QVector<int> evicted = m_thumbModel->evictIconsOutside(firstRow - keep, lastRow + keep);
+    if (!evicted.isEmpty()) m_thumbLoader->forgetDelivered(evicted);
+}
+
+void MainWindow::onThumbnailsReady(QVector<ThumbnailResult> results) {
+    // Icons arrive composed at the right size; all that's left is the swap
+    QSize iconSize = m_gridView->iconSize() * devicePixelRatioF();
+    
+    for (const ThumbnailResult& result : results) {
+        // Composed for a zoom level we already left
+        if (result.icon.size() != iconSize) continue;
+        m_thumbModel->setIcon(result.index, result.path, QPixmap::fromImage(result.icon));
     }
 }
 
 void MainWindow::resizeEvent(QResizeEvent *event) {
     QMainWindow::resizeEvent(event);
     if (m_stackedWidget->currentIndex() == 0) {
-        // Debounce?
-        QTimer::singleShot(200, this, [this](){
-            calculatePagination();
-            // Only refresh if page count changed significantly? 
-            // Or just refresh to fit new layout
-            displayCurrentPage();
-        });
+        // The view relayouts itself; only the loader's range needs refreshing
+        m_visibleRangeTimer->start();
     }
 }
 
@@ -364,27 +581,17 @@ void MainWindow::closeEvent(QCloseEvent *event) {
     QMainWindow::closeEvent(event);
 }
 
-void MainWindow::nextPage() {
-    if (m_currentPage < m_totalPages - 1) {
-        m_currentPage++;
-        displayCurrentPage();
-    }
-}
-
-void MainWindow::prevPage() {
-    if (m_currentPage > 0) {
-        m_currentPage--;
-        displayCurrentPage();
-    }
-}
-
 void MainWindow::startSlideshow() {
+    // Scan may still be running; show what the grid shows
+    if (m_scanner->isRunning()) m_slideshowPage->setImagePaths(m_displayImagePaths);
     m_slideshowPage->startSlideshow(0);
     toggleControls();
 }
 
-void MainWindow::onThumbnailClicked(QListWidgetItem* item) {
-    int idx = item->data(Qt::UserRole).toInt();
+void MainWindow::onThumbnailClicked(const QModelIndex& index) {
+    if (!index.isValid()) return;
+    int idx = index.row();
+    if (m_scanner->isRunning()) m_slideshowPage->setImagePaths(m_displayImagePaths);
     m_slideshowPage->startSlideshow(idx);
     toggleControls();
 }
@@ -419,10 +626,10 @@ void MainWindow::keyPressEvent(QKeyEvent *event) {
         }
     } else if (event->key() == Qt::Key_Right) {
         if (m_stackedWidget->currentIndex() == 1) m_slideshowPage->nextSlide();
-        else nextPage();
     } else if (event->key() == Qt::Key_Left) {
         if (m_stackedWidget->currentIndex() == 1) m_slideshowPage->prevSlide();
-        else prevPage();
+    } else {
+        QMainWindow::keyPressEvent(event);
     }
 }
 
@@ -10,10 +10,16 @@
 #include <QLineEdit>
 #include <QTextEdit>
 #include <QScrollArea>
-#include <QListWidget>
+#include <QListView>
 #include <QSlider> 
+#include <QTimer>
 
 #include "ThumbnailLoader.h"
+#include "ThumbnailModel.h"
+#include "ThumbnailDelegate.h"
+#include "DirectoryScanner.h"
+#include "LibraryIndex.h"
+#include "LibraryWatcher.h"
 #include "SlideshowWidget.h"
 
 // Forward decl
@@ -41,21 +47,30 @@ private slots:
     void saveSettings();
     void clearCache();
     
-    // Pagination
-    void nextPage();
-    void prevPage();
+    // Thumbnails
+    void onThumbnailsReady(QVector<ThumbnailResult> results);
+    void onThumbnailClicked(const QModelIndex& index);
+    void updateVisibleRange();
 
+    // Folder scan
+    void onFilesFound(QVector<ScannedFile> files);
+    void onDirectoriesFound(QStringList directories);
+    void onScanProgress(int files, int directories);
+    void onScanFinished();
     
-    // Thumbnails
-    void onThumbnailReady(int index, QString path, QImage image);
-    void onThumbnailClicked(QListWidgetItem* item);
+    // Library
+    void onLibraryChanged(QVector<LibraryChange> changes);
+    void onRandomOrderToggled();
+    void rescanLibrary(); // Background catch-up against the index
+    void saveLibraryIndex();
 
 private:
     void setupUi();
     void setupConnections();
     void populateThumbnails();
-    void displayCurrentPage();
-    void calculatePagination();
+    void applyZoom(int value);
+    void orderPaths(QStringList& paths) const; // Sort or shuffle per config
+    void insertOrdered(QStringList& paths, QStringList added) const; // Into an already ordered list
 
     // UI Elements
     QWidget* m_centralWidget;
@@ -88,30 +103,32 @@ private:
     QTextEdit* m_txtFolderDisplay;
     QLabel* m_lblCachePath;
     
-    // Thumbs
-    QListWidget* m_listWidget; // Using QListWidget for IconMode
-    
-    // Pagination
-    QWidget* m_paginationFrame;
-    QPushButton* m_btnPrevPage;
-    QLabel* m_lblPage;
-    QPushButton* m_btnNextPage;
+    // Thumbs: virtualized, only visible cells are ever painted
+    QListView* m_gridView;
+    ThumbnailModel* m_thumbModel;
+    ThumbnailDelegate* m_thumbDelegate;
+    QTimer* m_visibleRangeTimer; // Coalesces scroll/resize/zoom into one update
+    QLabel* m_lblCount;
     
     // Page 1: Slideshow
     SlideshowWidget* m_slideshowPage;
 
     // Logic
+    DirectoryScanner* m_scanner;
+    LibraryIndex m_library;
+    LibraryWatcher* m_watcher;
+    QTimer* m_librarySaveTimer; // Coalesces index writes after changes
+    bool m_reconciling; // Scan runs behind an index that's already shown
+    QHash<QString, LibraryEntry> m_scanned; // What the reconcile scan found
+    QStringList m_scannedDirs;
     ThumbnailLoader* m_thumbLoader;
     QThread* m_thumbThread;
     
     QStringList m_allImagePaths;
     QStringList m_displayImagePaths; // might be shuffled
     
-    int m_currentPage;
-    int m_totalPages;
-    int m_thumbsPerPage;
-    int m_cols;
-    int m_rows;
+    int m_visibleFirst;
+    int m_visibleLast;
     
     bool m_controlsVisible;
 };
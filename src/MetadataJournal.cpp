@@ -0,0 +1,231 @@
+#include "MetadataJournal.h"
+#include "FastHash.h"
+#include <QDataStream>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtEndian>
+#include <QDebug>
+#include <cerrno>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+const quint32 kSnapshotMagic = 0x444d5353; // "SSMD"
+const quint32 kSnapshotVersion = 3;
+const int kMinCheckpointRecords = 4096;
+const int kSyncEveryRecords = 256; // Bounds the loss on power cut without an fsync per record
+// Frames are [length][payload][xxHash64 of payload]. Older versions ended
+// them with a 16-bit qChecksum in 4 bytes, which a long replay of a damaged
+// journal would pass now and then.
+const int kFrameHead = 4;
+const int kFrameTail = 8;
+const int kLegacyFrameTail = 4;
+
+// Size of the frame at pos if it's intact, else 0
+int checkFrame(const QByteArray& data, int pos, bool legacy) {
+    int tail = legacy ? kLegacyFrameTail : kFrameTail;
+    if (pos + kFrameHead + tail > data.size()) return 0;
+    quint32 length = qFromLittleEndian<quint32>(data.constData() + pos);
+    if (length > (quint32)(data.size() - pos - kFrameHead - tail)) return 0;
+
+    const char* payload = data.constData() + pos + kFrameHead;
+    bool intact = legacy ? qFromLittleEndian<quint32>(payload + length) == qChecksum(payload, length)
+                         : qFromLittleEndian<quint64>(payload + length) == FastHash::xxh64(payload, length);
+    return intact ? kFrameHead + (int)length + tail : 0;
+}
+
+QDataStream& operator<<(QDataStream& out, const CacheMetadata& meta) {
+    return out << meta.lastModified << meta.fileSize << meta.sizeBytes << meta.lastAccess
+               << meta.cacheKey << meta.previewEdge;
+}
+
+QDataStream& operator>>(QDataStream& in, CacheMetadata& meta) {
+    return in >> meta.lastModified >> meta.fileSize >> meta.sizeBytes >> meta.lastAccess
+              >> meta.cacheKey >> meta.previewEdge;
+}
+
+// Version 2 layout: no source file size
+void readV2(QDataStream& in, CacheMetadata& meta) {
+    in >> meta.lastModified >> meta.sizeBytes >> meta.lastAccess >> meta.cacheKey
+       >> meta.previewEdge;
+    meta.fileSize = -1;
+}
+
+// A rename is only durable once the directory entry is
+void syncDirectory(const QString& dir) {
+#ifdef Q_OS_UNIX
+    int fd = ::open(QFile::encodeName(dir).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return;
+    ::fsync(fd);
+    ::close(fd);
+#else
+    Q_UNUSED(dir);
+#endif
+}
+}
+
+MetadataJournal::MetadataJournal(const QString& dir)
+    : m_snapshotFile(dir + "/metadata.bin"),
+      m_journalFile(dir + "/metadata.journal"),
+      m_journalRecords(0),
+      m_unsyncedRecords(0)
+{
+}
+
+MetadataJournal::~MetadataJournal() {
+    sync();
+    m_journal.close();
+}
+
+bool MetadataJournal::load(QMap<QString, CacheMetadata>& metadata) {
+    bool found = false;
+
+    QFile snapshot(m_snapshotFile);
+    if (snapshot.open(QIODevice::ReadOnly)) {
+        QDataStream in(&snapshot);
+        quint32 magic = 0, version = 0, count = 0;
+        in >> magic >> version >> count;
+        if (magic == kSnapshotMagic && (version == kSnapshotVersion || version == 2)) {
+            for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+                QString path;
+                CacheMetadata meta;
+                in >> path;
+                if (version == 2) readV2(in, meta);
+                else in >> meta;
+                if (in.status() == QDataStream::Ok) metadata.insert(path, meta);
+            }
+            found = true;
+        } else {
+            qWarning() << "Ignoring thumbnail metadata snapshot with unknown format";
+        }
+    }
+
+    // Replay, stopping at the first torn frame. A whole journal is in one
+    // format; an old one is recognised by its first frame.
+    m_journalRecords = 0;
+    bool legacy = false;
+    QFile journal(m_journalFile);
+    if (journal.open(QIODevice::ReadOnly)) {
+        QByteArray data = journal.readAll();
+        legacy = checkFrame(data, 0, false) == 0 && checkFrame(data, 0, true) > 0;
+        int pos = 0;
+        while (int size = checkFrame(data, pos, legacy)) {
+            quint32 length = qFromLittleEndian<quint32>(data.constData() + pos);
+            QDataStream in(QByteArray::fromRawData(data.constData() + pos + kFrameHead, length));
+            quint8 op = 0;
+            QString path;
+            in >> op >> path;
+            if (op == OpPut || op == OpPutV2) {
+                CacheMetadata meta;
+                if (op == OpPutV2) readV2(in, meta);
+                else in >> meta;
+                if (in.status() == QDataStream::Ok) metadata.insert(path, meta);
+            } else if (op == OpRemove) {
+                metadata.remove(path);
+            }
+
+            pos += size;
+            m_journalRecords++;
+            found = true;
+        }
+        journal.close();
+
+        // Drop a torn tail so new appends follow the last good record
+        if (pos < data.size()) {
+            QFile::resize(m_journalFile, pos);
+        }
+    }
+
+    if (legacy) {
+        // Fold it into a snapshot so new frames never follow old ones
+        checkpoint(metadata);
+    } else {
+        openJournal(false);
+    }
+    return found;
+}
+
+void MetadataJournal::openJournal(bool truncate) {
+    m_journal.close();
+    m_journal.setFileName(m_journalFile);
+    QIODevice::OpenMode mode = QIODevice::WriteOnly | (truncate ? QIODevice::Truncate : QIODevice::Append);
+    if (!m_journal.open(mode)) {
+        qWarning() << "Could not open thumbnail metadata journal" << m_journalFile;
+    }
+}
+
+void MetadataJournal::appendRecord(const QByteArray& payload) {
+    if (!m_journal.isOpen()) return;
+
+    QByteArray frame(kFrameHead + payload.size() + kFrameTail, Qt::Uninitialized);
+    qToLittleEndian<quint32>(payload.size(), frame.data());
+    memcpy(frame.data() + kFrameHead, payload.constData(), payload.size());
+    qToLittleEndian<quint64>(FastHash::xxh64(payload.constData(), payload.size()),
+                             frame.data() + kFrameHead + payload.size());
+
+    // One write per record; flushed so an app crash loses nothing committed
+    m_journal.write(frame);
+    m_journal.flush();
+    m_journalRecords++;
+    if (++m_unsyncedRecords >= kSyncEveryRecords) sync();
+}
+
+void MetadataJournal::sync() {
+    if (!m_journal.isOpen() || m_unsyncedRecords == 0) return;
+    m_journal.flush();
+#ifdef Q_OS_UNIX
+    if (::fsync(m_journal.handle()) != 0) {
+        qWarning() << "Could not sync thumbnail metadata journal" << m_journalFile << strerror(errno);
+    }
+#endif
+    m_unsyncedRecords = 0;
+}
+
+void MetadataJournal::recordPut(const QString& path, const CacheMetadata& meta) {
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << (quint8)OpPut << path << meta;
+    appendRecord(payload);
+}
+
+void MetadataJournal::recordRemove(const QString& path) {
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << (quint8)OpRemove << path;
+    appendRecord(payload);
+}
+
+bool MetadataJournal::needsCheckpoint(int liveEntries) const {
+    // Amortised: replay never costs more than about twice the snapshot
+    return m_journalRecords > qMax(kMinCheckpointRecords, liveEntries);
+}
+
+void MetadataJournal::checkpoint(const QMap<QString, CacheMetadata>& metadata) {
+    QSaveFile snapshot(m_snapshotFile);
+    if (!snapshot.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not write thumbnail metadata snapshot" << m_snapshotFile;
+        return;
+    }
+
+    QDataStream out(&snapshot);
+    out << kSnapshotMagic << kSnapshotVersion << (quint32)metadata.size();
+    for (auto it = metadata.constBegin(); it != metadata.constEnd(); ++it) {
+        out << it.key() << it.value();
+    }
+
+    // Snapshot is atomically in place, and the rename on disk, before the
+    // journal is dropped. commit() syncs the data itself. A crash in between
+    // just replays records the snapshot already contains.
+    if (!snapshot.commit()) {
+        qWarning() << "Could not commit thumbnail metadata snapshot" << m_snapshotFile;
+        return;
+    }
+    syncDirectory(QFileInfo(m_snapshotFile).absolutePath());
+    openJournal(true);
+    m_journalRecords = 0;
+    m_unsyncedRecords = 0;
+}
@@ -0,0 +1,53 @@
+#ifndef METADATAJOURNAL_H
+#define METADATAJOURNAL_H
+
+#include <QString>
+#include <QMap>
+#include <QFile>
+
+struct CacheMetadata {
+    qint64 lastModified;
+    qint64 fileSize; // Of the source image, -1 if unknown (written by an older version)
+    qint64 sizeBytes;
+    qint64 lastAccess;
+    QString cacheKey; // Content key (FastHash::fileKey); shared by duplicates
+    qint32 previewEdge; // Longest edge of the EXIF preview it came from, 0 = full decode
+};
+
+// Binary thumbnail metadata: a checkpoint snapshot plus an append-only journal.
+// Each put/remove is one small framed append, so an app crash only loses the
+// record being written; a power cut loses at most what came since the last
+// sync(). The journal is folded into a new snapshot once it grows past the
+// live entry count, keeping replay bounded.
+// Owned by the loader thread, not thread-safe.
+class MetadataJournal {
+public:
+    explicit MetadataJournal(const QString& dir);
+    ~MetadataJournal();
+
+    // Snapshot then journal replay. Returns false if nothing was on disk.
+    bool load(QMap<QString, CacheMetadata>& metadata);
+
+    void recordPut(const QString& path, const CacheMetadata& meta);
+    void recordRemove(const QString& path);
+    // Puts appended records on disk. Call after a batch; appends also sync
+    // on their own every so often.
+    void sync();
+
+    bool needsCheckpoint(int liveEntries) const;
+    void checkpoint(const QMap<QString, CacheMetadata>& metadata);
+
+private:
+    enum Op : quint8 { OpPutV2 = 1, OpRemove = 2, OpPut = 3 };
+
+    void openJournal(bool truncate);
+    void appendRecord(const QByteArray& payload);
+
+    QString m_snapshotFile;
+    QString m_journalFile;
+    QFile m_journal;
+    int m_journalRecords;
+    int m_unsyncedRecords;
+};
+
+#endif // METADATAJOURNAL_H
@@ -0,0 +1,124 @@
+#include "Metrics.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+enum Type { CounterType, GaugeType, HistogramType };
+
+struct Entry {
+    const char* name;
+    const char* help;
+    Type type;
+    void* metric;
+};
+
+// Function-local so registering from a static initializer is safe
+struct Registry {
+    QMutex mutex;
+    QVector<Entry> entries; // Registration order is exposition order
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+template <typename T, typename Make>
+T* lookup(const char* name, const char* help, Type type, Make make) {
+    Registry& r = registry();
+    QMutexLocker locker(&r.mutex);
+    for (const Entry& e : r.entries) {
+        if (strcmp(e.name, name) == 0) {
+            Q_ASSERT(e.type == type);
+            return static_cast<T*>(e.metric);
+        }
+    }
+    T* metric = make();
+    r.entries.append({name, help, type, metric});
+    return metric;
+}
+
+QByteArray number(double value) {
+    return QByteArray::number(value, 'g', 12);
+}
+
+void header(QByteArray& out, const Entry& e, const char* type) {
+    out += "# HELP ";
+    out += e.name;
+    out += ' ';
+    out += e.help;
+    out += "\n# TYPE ";
+    out += e.name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+}
+
+Metrics::Histogram::Histogram(const QVector<double>& bounds)
+    : m_bounds(bounds), m_counts(bounds.size() + 1, 0), m_sum(0.0), m_count(0)
+{
+}
+
+void Metrics::Histogram::observe(double value) {
+    int bucket = std::lower_bound(m_bounds.constBegin(), m_bounds.constEnd(), value) - m_bounds.constBegin();
+    QMutexLocker locker(&m_mutex);
+    m_counts[bucket]++;
+    m_sum += value;
+    m_count++;
+}
+
+Metrics::Counter* Metrics::counter(const char* name, const char* help) {
+    return lookup<Counter>(name, help, CounterType, [] { return new Counter; });
+}
+
+Metrics::Gauge* Metrics::gauge(const char* name, const char* help) {
+    return lookup<Gauge>(name, help, GaugeType, [] { return new Gauge; });
+}
+
+Metrics::Histogram* Metrics::histogram(const char* name, const char* help, const QVector<double>& bounds) {
+    return lookup<Histogram>(name, help, HistogramType, [&bounds] { return new Histogram(bounds); });
+}
+
+QByteArray Metrics::render() {
+    QVector<Entry> entries;
+    {
+        Registry& r = registry();
+        QMutexLocker locker(&r.mutex);
+        entries = r.entries;
+    }
+
+    QByteArray out;
+    for (const Entry& e : entries) {
+        switch (e.type) {
+        case CounterType:
+            header(out, e, "counter");
+            out += e.name;
+            out += ' ' + QByteArray::number(static_cast<Counter*>(e.metric)->value()) + '\n';
+            break;
+        case GaugeType:
+            header(out, e, "gauge");
+            out += e.name;
+            out += ' ' + QByteArray::number(static_cast<Gauge*>(e.metric)->value()) + '\n';
+            break;
+        case HistogramType: {
+            header(out, e, "histogram");
+            const Histogram* h = static_cast<Histogram*>(e.metric);
+            QMutexLocker locker(&h->m_mutex);
+            quint64 cumulative = 0;
+            for (int i = 0; i <= h->m_bounds.size(); ++i) {
+                cumulative += h->m_counts[i];
+                QByteArray le = i < h->m_bounds.size() ? number(h->m_bounds[i]) : QByteArray("+Inf");
+                out += e.name;
+                out += "_bucket{le=\"" + le + "\"} " + QByteArray::number(cumulative) + '\n';
+            }
+            out += e.name;
+            out += "_sum " + number(h->m_sum) + '\n';
+            out += e.name;
+            out += "_count " + QByteArray::number(h->m_count) + '\n';
+            break;
+        }
+        }
+    }
+    return out;
+}
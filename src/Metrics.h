@@ -0,0 +1,62 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QMutex>
+#include <QVector>
+
+// Process-wide counters, gauges and histograms, rendered in Prometheus text
+// format for MetricsServer. Metrics are registered by name once and live
+// for the whole process; asking again for the same name returns the same
+// object, so several loaders can share one series.
+//
+// Counters and gauges are one atomic each, cheap enough for per-thumbnail
+// updates from any thread. Histograms take a short lock per observation.
+class Metrics {
+public:
+    class Counter {
+    public:
+        void add(quint64 n = 1) { m_value.fetchAndAddRelaxed(n); }
+        quint64 value() const { return m_value.loadAcquire(); }
+
+    private:
+        QAtomicInteger<quint64> m_value{0};
+    };
+
+    class Gauge {
+    public:
+        void set(qint64 value) { m_value.storeRelease(value); }
+        void add(qint64 delta) { m_value.fetchAndAddRelaxed(delta); }
+        qint64 value() const { return m_value.loadAcquire(); }
+
+    private:
+        QAtomicInteger<qint64> m_value{0};
+    };
+
+    // Cumulative buckets as Prometheus expects; bounds in ascending order,
+    // +Inf is implied
+    class Histogram {
+    public:
+        explicit Histogram(const QVector<double>& bounds);
+        void observe(double value);
+
+    private:
+        friend class Metrics;
+        mutable QMutex m_mutex;
+        QVector<double> m_bounds;
+        QVector<quint64> m_counts; // Per bucket, not cumulative; last is +Inf
+        double m_sum;
+        quint64 m_count;
+    };
+
+    // Names follow Prometheus rules; help is a single line
+    static Counter* counter(const char* name, const char* help);
+    static Gauge* gauge(const char* name, const char* help);
+    static Histogram* histogram(const char* name, const char* help, const QVector<double>& bounds);
+
+    // Every registered metric in exposition format 0.0.4
+    static QByteArray render();
+};
+
+#endif // METRICS_H
@@ -0,0 +1,69 @@
+#include "MetricsServer.h"
+#include "Metrics.h"
+#include <QDebug>
+#include <QHostAddress>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QVariant>
+
+namespace {
+const int kMaxRequestBytes = 8 * 1024;
+const int kClientTimeoutMs = 5000; // Drop clients that never finish a request
+}
+
+MetricsServer::MetricsServer(QObject* parent)
+    : QObject(parent), m_server(new QTcpServer(this))
+{
+    connect(m_server, &QTcpServer::newConnection, this, &MetricsServer::onNewConnection);
+}
+
+bool MetricsServer::listen(quint16 port) {
+    if (!m_server->listen(QHostAddress::LocalHost, port)) {
+        qWarning() << "Metrics: can't listen on 127.0.0.1:" << port << m_server->errorString();
+        return false;
+    }
+    qInfo() << "Metrics: serving http://127.0.0.1:" << port << "/metrics";
+    return true;
+}
+
+void MetricsServer::onNewConnection() {
+    while (QTcpSocket* socket = m_server->nextPendingConnection()) {
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { onReadyRead(socket); });
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        QTimer::singleShot(kClientTimeoutMs, socket, [socket]() { socket->abort(); });
+    }
+}
+
+void MetricsServer::onReadyRead(QTcpSocket* socket) {
+    // Headers only; wait until they're complete
+    QByteArray request = socket->property("request").toByteArray() + socket->readAll();
+    int end = request.indexOf("\r\n\r\n");
+    if (end < 0) {
+        if (request.size() > kMaxRequestBytes) socket->abort();
+        else socket->setProperty("request", request);
+        return;
+    }
+    socket->setProperty("request", QVariant());
+
+    QList<QByteArray> line = request.left(request.indexOf("\r\n")).split(' ');
+    if (line.size() != 3 || !line[2].startsWith("HTTP/1.")) {
+        respond(socket, "400 Bad Request", "bad request\n");
+    } else if (line[0] != "GET") {
+        respond(socket, "405 Method Not Allowed", "GET only\n");
+    } else if (line[1] != "/metrics" && !line[1].startsWith("/metrics?")) {
+        respond(socket, "404 Not Found", "try /metrics\n");
+    } else {
+        respond(socket, "200 OK", Metrics::render());
+    }
+}
+
+void MetricsServer::respond(QTcpSocket* socket, const QByteArray& status, const QByteArray& body) {
+    QByteArray head = "HTTP/1.1 " + status + "\r\n"
+                      "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                      "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                      "Connection: close\r\n\r\n";
+    disconnect(socket, &QTcpSocket::readyRead, this, nullptr); // One request per connection
+    socket->write(head + body);
+    socket->disconnectFromHost(); // After the write drains
+}
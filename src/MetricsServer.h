@@ -0,0 +1,27 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QObject>
+
+class QTcpServer;
+class QTcpSocket;
+
+// Serves Metrics::render() as GET /metrics on 127.0.0.1 only, for a local
+// Prometheus scraper or node exporter. Deliberately minimal HTTP: one
+// request per connection, no keep-alive, nothing but GET.
+class MetricsServer : public QObject {
+    Q_OBJECT
+public:
+    explicit MetricsServer(QObject* parent = nullptr);
+
+    bool listen(quint16 port);
+
+private:
+    void onNewConnection();
+    void onReadyRead(QTcpSocket* socket);
+    void respond(QTcpSocket* socket, const QByteArray& status, const QByteArray& body);
+
+    QTcpServer* m_server;
+};
+
+#endif // METRICSSERVER_H
@@ -1,24 +1,75 @@
 #include "SlideshowWidget.h"
 #include <QPainter>
+#include <QPaintEvent>
 #include <QDebug>
+#include <QFileInfo>
+#include <QSet>
+#include <QScreen>
+#include <QWindow>
+#include <QGuiApplication>
+#include <cmath>
 #include "ConfigManager.h"
+#include "Crossfade.h"
+#include "Trace.h"
+#include "Metrics.h"
+
+namespace {
+// Slides decoded ahead of the current one, at most. Each is a full
+// widget-sized image, so this is the ring's memory bound.
+const int kMaxAhead = 3;
+// Slack on top of the learned decode time before a slide is due
+const qint64 kLeadMarginMs = 250;
+// Starting guess for files never decoded; learned from there
+const double kInitialMsPerMB = 60.0;
+// Headroom on the measured render cost when picking a frame interval
+const double kRenderHeadroom = 1.25;
+// Ken Burns: zoom changes by this much over a slide's time on screen,
+// somewhere between 1x and the pyramid's top level (2x the cover size)
+const double kKenBurnsTravel = 0.25;
+const double kKenBurnsMaxZoom = 2.0;
+
+Metrics::Histogram* transitionLateness() {
+    static Metrics::Histogram* h = Metrics::histogram(
+        "slideshow_transition_late_seconds", "How late timed slide changes started their fade",
+        {0.02, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5});
+    return h;
+}
+
+Metrics::Histogram* fadeDroppedFrames() {
+    static Metrics::Histogram* h = Metrics::histogram(
+        "slideshow_fade_dropped_frames", "Frames dropped per finished fade",
+        {0, 1, 2, 5, 10, 20, 50});
+    return h;
+}
+}
 
 SlideshowWidget::SlideshowWidget(QWidget *parent)
-    : QWidget(parent), m_currentIndex(-1), m_nextIndex(-1), 
-      m_running(false), m_paused(false), m_isTransitioning(false), m_opacity(0.0)
+    : QWidget(parent), m_currentIndex(-1), m_nextIndex(-1), m_current(), m_next(),
+      m_running(false), m_paused(false), m_kenBurns(false), m_isTransitioning(false), m_opacity(0.0),
+      m_fadeStartedAt(0), m_pausedAt(0), m_lastTickAt(0), m_renderMs(0.0),
+      m_fadeLate(0), m_fadeDropped(0), m_lateFrames(0), m_droppedFrames(0),
+      m_currentToken(0), m_nextToken(0),
+      m_msPerMB(kInitialMsPerMB), m_transitionDueAt(-1)
 {
     setAttribute(Qt::WA_OpaquePaintEvent); // Optimization
     setAutoFillBackground(false); 
     
     m_animationTimer = new QTimer(this);
-    m_animationTimer->setInterval(16); // ~60 FPS
+    m_animationTimer->setInterval(16); // ~60 FPS until the first fade measures the display
+    m_animationTimer->setTimerType(Qt::PreciseTimer);
     connect(m_animationTimer, &QTimer::timeout, this, &SlideshowWidget::updateAnimation);
     
     m_slideTimer = new QTimer(this);
     m_slideTimer->setSingleShot(true);
     connect(m_slideTimer, &QTimer::timeout, this, &SlideshowWidget::nextSlide);
     
+    m_prefetchTimer = new QTimer(this);
+    m_prefetchTimer->setSingleShot(true);
+    connect(m_prefetchTimer, &QTimer::timeout, this, &SlideshowWidget::updatePrefetch);
+    m_clock.start();
+    
     m_imageLoader = new ImageCacheLoader(this);
+    m_imageLoader->setCacheMaxSizeMB(ConfigManager::instance().slideCacheMaxSizeMB());
     connect(m_imageLoader, &ImageCacheLoader::imageLoaded, this, &SlideshowWidget::onImageLoaded);
 }
 
@@ -28,6 +79,68 @@ SlideshowWidget::~SlideshowWidget() {
 
 void SlideshowWidget::setImagePaths(const QStringList& paths) {
     m_paths = paths;
+    // Ring is keyed by path, so whatever survives in the new list stays usable
+    updatePrefetch();
+}
+
+void SlideshowWidget::updateImagePaths(const QStringList& paths, const QHash<QString, QString>& renamed) {
+    if (m_currentIndex < 0 || m_currentIndex >= m_paths.size()) {
+        m_paths = paths;
+        return;
+    }
+    
+    QHash<QString, int> rowOf;
+    rowOf.reserve(paths.size());
+    for (int i = 0; i < paths.size(); ++i) rowOf.insert(paths[i], i);
+    
+    // New row of an old one; if it's gone, the row just before where it was
+    auto remap = [&](int oldIndex, bool* gone) {
+        QString path = m_paths[oldIndex];
+        path = renamed.value(path, path);
+        auto it = rowOf.constFind(path);
+        if (it != rowOf.constEnd()) {
+            *gone = false;
+            return it.value();
+        }
+        *gone = true;
+        for (int i = oldIndex - 1; i >= 0; --i) {
+            QString before = renamed.value(m_paths[i], m_paths[i]);
+            auto prev = rowOf.constFind(before);
+            if (prev != rowOf.constEnd()) return prev.value();
+        }
+        return -1;
+    };
+    
+    bool currentGone = false;
+    bool nextGone = false;
+    int current = remap(m_currentIndex, &currentGone);
+    int next = -1;
+    if (m_nextIndex >= 0 && m_nextIndex < m_paths.size()) next = remap(m_nextIndex, &nextGone);
+    else m_nextIndex = -1;
+    
+    m_paths = paths;
+    if (m_paths.isEmpty()) {
+        stopSlideshow();
+        m_currentIndex = -1;
+        m_nextIndex = -1;
+        return;
+    }
+    
+    // A removed current slide stays on screen; "next" is the one after its old spot
+    m_currentIndex = qMax(0, current);
+    
+    if (m_nextIndex != -1) {
+        if (!nextGone) {
+            m_nextIndex = next;
+        } else if (m_isTransitioning) {
+            m_nextIndex = qMax(0, next); // Already decoded, let the fade finish
+        } else {
+            // Still loading something that no longer exists: move on instead
+            m_nextIndex = -1;
+            if (m_running && !m_paused) m_slideTimer->start(0);
+        }
+    }
+    updatePrefetch();
 }
 
 void SlideshowWidget::startSlideshow(int startIndex) {
@@ -36,6 +149,16 @@ void SlideshowWidget::startSlideshow(int startIndex) {
     m_currentIndex = startIndex;
     if (m_currentIndex < 0 || m_currentIndex >= m_paths.size()) m_currentIndex = 0;
     
+    // Settings may have changed since the last run
+    m_imageLoader->setCacheMaxSizeMB(ConfigManager::instance().slideCacheMaxSizeMB());
+    if (ConfigManager::instance().kenBurns() != m_kenBurns) {
+        // Pyramids vs. letterboxed frames: nothing decoded so far fits
+        m_kenBurns = ConfigManager::instance().kenBurns();
+        m_ring.clear();
+        cancelPending();
+        m_current = Frame();
+    }
+    
     m_running = true;
     m_paused = false;
     m_isTransitioning = false;
@@ -43,26 +166,41 @@ void SlideshowWidget::startSlideshow(int startIndex) {
     
     // Load current directly for instant start?
     // We'll request it and show black until loaded
-    m_currentImage = QImage();
-    m_nextImage = QImage();
+    m_next = Frame();
     m_nextIndex = -1;
+    m_nextToken = 0;
+    m_transitionDueAt = -1;
     
-    m_imageLoader->requestImage(m_paths[m_currentIndex], size());
+    // Straight from the ring if it's there (e.g. restarting on a nearby slide).
+    // Pan/zoom starts as if it had just faded in.
+    const QString& path = m_paths[m_currentIndex];
+    m_current.shownAt = m_clock.elapsed() - (qint64)(ConfigManager::instance().transitionTime() * 1000);
+    showFrame(m_ring.value(path));
+    m_currentToken = 0;
+    if (m_current.viewSize != size()) m_currentToken = requestSlide(m_currentIndex, ImageCacheLoader::Current);
+    if (m_kenBurns) {
+        m_lastTickAt = m_clock.elapsed();
+        adaptFrameInterval();
+        m_animationTimer->start();
+    }
     
     // Schedule next slide
     double dur = ConfigManager::instance().slideDuration();
     m_slideTimer->start(dur * 1000);
+    updatePrefetch();
 }
 
 void SlideshowWidget::stopSlideshow() {
     m_running = false;
     m_slideTimer->stop();
     m_animationTimer->stop();
+    m_prefetchTimer->stop();
     // Do not kill the loader thread here, keep it alive for next run
     // m_imageLoader->requestInterruption(); 
 }
 
 void SlideshowWidget::pause() {
+    if (!m_paused) m_pausedAt = m_clock.elapsed(); // Fade and pan/zoom resume from here
     m_paused = true;
     m_slideTimer->stop(); // freeze timer
     m_animationTimer->stop(); 
@@ -73,27 +211,33 @@ void SlideshowWidget::resume() {
         m_paused = false;
         // restart timer? or just resume?
         // simple resume:
+        // Carry on from the same point in the fade and pan/zoom
+        qint64 now = m_clock.elapsed();
+        m_fadeStartedAt += now - m_pausedAt;
+        m_current.shownAt += now - m_pausedAt;
+        m_next.shownAt += now - m_pausedAt;
+        m_lastTickAt = now;
         if (!m_isTransitioning) {
              m_slideTimer->start(ConfigManager::instance().slideDuration() * 1000);
-        } else {
+        }
+        if (m_isTransitioning || m_kenBurns) {
              m_animationTimer->start();
         }
+        updatePrefetch();
     }
 }
 
 void SlideshowWidget::nextSlide() {
+    TRACE_SCOPE("slideshow.nextSlide");
     if (m_paths.isEmpty() || !m_running || m_paused) return;
     
-    int next = m_currentIndex + 1;
-    if (next >= m_paths.size()) {
-        if (ConfigManager::instance().continuousLoop()) {
-            next = 0;
-        } else {
-            stopSlideshow();
-            return;
-        }
+    int next = slideAfter(m_currentIndex, 1);
+    if (next < 0) {
+        stopSlideshow();
+        return;
     }
     
+    m_transitionDueAt = m_clock.elapsed();
     transitionToImage(next);
 }
 
@@ -101,86 +245,432 @@ void SlideshowWidget::prevSlide() {
     // Manual nav
     if (m_paths.isEmpty()) return;
     
-    int prev = m_currentIndex - 1;
-    if (prev < 0) prev = m_paths.size() - 1;
-    
-    transitionToImage(prev);
+    m_transitionDueAt = -1;
+    transitionToImage(slideBefore(m_currentIndex));
+}
+
+int SlideshowWidget::slideAfter(int index, int steps) const {
+    // m_paths is already in show order (shuffled when randomOrder is on)
+    int next = index + steps;
+    if (next < m_paths.size()) return next;
+    if (!ConfigManager::instance().continuousLoop()) return -1;
+    return next % m_paths.size();
+}
+
+int SlideshowWidget::slideBefore(int index) const {
+    return index > 0 ? index - 1 : m_paths.size() - 1;
 }
 
 void SlideshowWidget::transitionToImage(int index) {
     if (index < 0 || index >= m_paths.size()) return;
     
     m_nextIndex = index;
-    // Request image
-    m_imageLoader->requestImage(m_paths[m_nextIndex], size());
+    m_nextToken = 0;
+    auto ready = m_ring.constFind(m_paths[m_nextIndex]);
+    if (ready != m_ring.constEnd()) {
+        beginTransition(ready.value());
+        return;
+    }
+    
+    // Not decoded yet: the fade starts when it arrives, late. Jumps the
+    // queue if it was only prefetching.
+    m_nextToken = requestSlide(m_nextIndex, ImageCacheLoader::Current);
+    updatePrefetch();
+}
+
+void SlideshowWidget::beginTransition(const Frame& frame) {
+    if (m_transitionDueAt >= 0) {
+        qint64 late = m_clock.elapsed() - m_transitionDueAt;
+        transitionLateness()->observe(late / 1000.0);
+        m_transitionDueAt = -1;
+    }
+    
+    m_next = frame;
+    m_nextToken = 0;
+    m_isTransitioning = true;
+    m_opacity = 0.0;
+    
+    m_fadeStartedAt = m_clock.elapsed();
+    m_next.shownAt = m_fadeStartedAt;
+    m_lastTickAt = m_fadeStartedAt;
+    m_fadeLate = 0;
+    m_fadeDropped = 0;
+    adaptFrameInterval();
+    m_animationTimer->start();
+}
+
+void SlideshowWidget::onImageLoaded(quint64 token, QString path, SlideFrame slide, int decodeMs) {
+    // Anything we no longer track was cancelled or re-requested since
+    auto pending = m_pending.find(path);
+    if (pending == m_pending.end() || pending->token != token) return;
+    m_pending.erase(pending);
+    TRACE_ASYNC_END("slide", token);
+    TRACE_SCOPE("slideshow.imageLoaded");
+    learnDecodeTime(path, decodeMs);
+    Frame frame;
+    static_cast<SlideFrame&>(frame) = slide;
+    frame.viewSize = size(); // Pending requests are all for the current size
+    frame.seed = qHash(path);
+    frame.shownAt = 0;
+    m_ring.insert(path, frame);
+    
+    if (token == m_currentToken) {
+        // Started up on (or resized under) a slide that wasn't decoded yet
+        m_currentToken = 0;
+        showFrame(frame);
+    } else if (token == m_nextToken && !m_isTransitioning) {
+        // The transition was due already and waited for this
+        beginTransition(frame);
+    }
+    
+    updatePrefetch();
+}
+
+qint64 SlideshowWidget::msUntilNextTransition() const {
+    if (!m_running || m_paused) return -1;
+    double transitionMs = ConfigManager::instance().transitionTime() * 1000;
+    double slideMs = ConfigManager::instance().slideDuration() * 1000;
+    if (m_isTransitioning) return (qint64)((1.0 - m_opacity) * transitionMs + slideMs);
+    if (m_slideTimer->isActive()) return m_slideTimer->remainingTime();
+    return 0; // Due now, waiting on a decode
+}
+
+qint64 SlideshowWidget::estimateDecodeMs(const QString& path) const {
+    auto known = m_decodeMs.constFind(path);
+    if (known != m_decodeMs.constEnd()) return (qint64)known.value();
+    // Never decoded: scale by file size at the rate seen so far
+    double mb = QFileInfo(path).size() / (1024.0 * 1024.0);
+    return (qint64)(qMax(1.0, mb) * m_msPerMB);
+}
+
+void SlideshowWidget::learnDecodeTime(const QString& path, int decodeMs) {
+    if (decodeMs < 0) return;
+    auto known = m_decodeMs.find(path);
+    if (known != m_decodeMs.end()) known.value() = 0.5 * known.value() + 0.5 * decodeMs;
+    else m_decodeMs.insert(path, decodeMs);
+    
+    double mb = QFileInfo(path).size() / (1024.0 * 1024.0);
+    if (mb > 0.1) m_msPerMB = 0.8 * m_msPerMB + 0.2 * (decodeMs / mb);
+}
+
+quint64 SlideshowWidget::requestSlide(int index, ImageCacheLoader::Priority priority) {
+    const QString& path = m_paths[index];
+    if (m_ring.contains(path)) return 0;
+    
+    auto pending = m_pending.find(path);
+    if (pending != m_pending.end()) {
+        if (priority < pending->priority) {
+            pending->priority = priority;
+            m_imageLoader->setPriority(pending->token, priority);
+        }
+        return pending->token;
+    }
     
-    // We wait for onImageLoaded to actually start the animation
+    quint64 token = m_imageLoader->requestImage(path, size(), priority, m_kenBurns);
+    m_pending.insert(path, {token, priority, estimateDecodeMs(path)});
+    TRACE_ASYNC_BEGIN("slide", token); // Request to delivery, across threads
+    return token;
+}
+
+void SlideshowWidget::cancelPending() {
+    for (auto it = m_pending.constBegin(); it != m_pending.constEnd(); ++it) {
+        m_imageLoader->cancel(it->token);
+        TRACE_ASYNC_END("slide", it->token);
+    }
+    m_pending.clear();
 }
 
-void SlideshowWidget::onImageLoaded(QString path, QImage image) {
-    // Check if this is the image we are waiting for
-    // If we are starting up (currentIndex defined but m_currentImage null)
-    if (m_currentImage.isNull() && !m_paths.isEmpty() && path == m_paths[m_currentIndex]) {
-        m_currentImage = image;
-        update();
+void SlideshowWidget::updatePrefetch() {
+    m_prefetchTimer->stop();
+    if (m_paths.isEmpty() || m_currentIndex < 0 || m_currentIndex >= m_paths.size()) {
+        m_ring.clear();
+        cancelPending();
         return;
     }
     
-    // If we are transitioning
-    if (m_nextIndex != -1 && path == m_paths[m_nextIndex]) {
-        m_nextImage = image;
-        m_isTransitioning = true;
-        m_opacity = 0.0;
-        m_animationTimer->start();
+    QSet<QString> keep;
+    keep.insert(m_paths[m_currentIndex]);
+    // Whatever the screen is waiting on; re-asks after a resize or rename.
+    // A frame of the wrong size stays up until its replacement arrives.
+    if (m_current.viewSize != size()) {
+        auto ready = m_ring.constFind(m_paths[m_currentIndex]);
+        if (ready != m_ring.constEnd()) {
+            m_currentToken = 0;
+            showFrame(ready.value());
+        } else {
+            m_currentToken = requestSlide(m_currentIndex, ImageCacheLoader::Current);
+        }
+    }
+    if (m_nextIndex >= 0 && m_nextIndex < m_paths.size()) {
+        keep.insert(m_paths[m_nextIndex]);
+        if (!m_isTransitioning) m_nextToken = requestSlide(m_nextIndex, ImageCacheLoader::Current);
     }
+    
+    // Neighbours: always, right away
+    int next = slideAfter(m_currentIndex, 1);
+    if (next >= 0) {
+        keep.insert(m_paths[next]);
+        requestSlide(next, ImageCacheLoader::Next);
+    }
+    int prev = slideBefore(m_currentIndex);
+    keep.insert(m_paths[prev]);
+    requestSlide(prev, ImageCacheLoader::Prefetch);
+    
+    // Further ahead: only once the slide is due within its decode time,
+    // plus its share of what's queued in front of it across the workers
+    qint64 untilNext = msUntilNextTransition();
+    qint64 period = (qint64)((ConfigManager::instance().slideDuration() +
+                              ConfigManager::instance().transitionTime()) * 1000);
+    qint64 queued = 0;
+    for (auto it = m_pending.constBegin(); it != m_pending.constEnd(); ++it) queued += it->estimateMs;
+    int workers = qMax(1, m_imageLoader->workerCount());
+    
+    for (int k = 2; k <= kMaxAhead && untilNext >= 0; ++k) {
+        int index = slideAfter(m_currentIndex, k);
+        if (index < 0 || index == m_currentIndex) break; // End of show, or a short loop came round
+        const QString& path = m_paths[index];
+        if (m_ring.contains(path) || m_pending.contains(path)) {
+            keep.insert(path);
+            continue;
+        }
+        
+        qint64 startsIn = untilNext + (k - 1) * period;
+        qint64 estimate = estimateDecodeMs(path);
+        qint64 lead = estimate * 3 / 2 + kLeadMarginMs + queued / workers;
+        if (startsIn > lead) {
+            // Later slides fall due later still; look again when this one does
+            m_prefetchTimer->start((int)qMin<qint64>(startsIn - lead, 60 * 1000));
+            break;
+        }
+        keep.insert(path);
+        requestSlide(index, ImageCacheLoader::Prefetch);
+        queued += estimate;
+    }
+    
+    for (auto it = m_ring.begin(); it != m_ring.end(); ) {
+        if (keep.contains(it.key())) ++it;
+        else it = m_ring.erase(it);
+    }
+    // Skipped past (e.g. holding an arrow key): don't spend decodes on them
+    for (auto it = m_pending.begin(); it != m_pending.end(); ) {
+        if (keep.contains(it.key())) {
+            ++it;
+        } else {
+            m_imageLoader->cancel(it->token);
+            TRACE_ASYNC_END("slide", it->token);
+            it = m_pending.erase(it);
+        }
+    }
+}
+
+void SlideshowWidget::resizeEvent(QResizeEvent *event) {
+    QWidget::resizeEvent(event);
+    // Everything decoded so far is sized for the old geometry. New frames
+    // are requested once the resize settles, not for every step of a drag.
+    m_ring.clear();
+    cancelPending();
+    m_prefetchTimer->start(100);
+    m_blendedImage = QImage(); // Reallocated at the new size by the next blend
+}
+
+bool SlideshowWidget::blendFrames(const QRect& area) {
+    TRACE_SCOPE("slideshow.blend");
+    const QImage::Format format = QImage::Format_ARGB32_Premultiplied;
+    if (m_current.image.size() != size() || m_next.image.size() != size() ||
+        m_current.image.format() != format || m_next.image.format() != format) {
+        return false;
+    }
+    if (m_blendedImage.size() != size()) m_blendedImage = QImage(size(), format);
+    
+    int alpha = qRound(m_opacity * 256);
+    int x = area.x();
+    for (int y = area.top(); y <= area.bottom(); ++y) {
+        Crossfade::blend(reinterpret_cast<const quint32*>(m_current.image.constScanLine(y)) + x,
+                         reinterpret_cast<const quint32*>(m_next.image.constScanLine(y)) + x,
+                         reinterpret_cast<quint32*>(m_blendedImage.scanLine(y)) + x, area.width(), alpha);
+    }
+    return true;
+}
+
+QRect SlideshowWidget::pictureRect(const QImage& image, const QRect& content) const {
+    if (image.isNull()) return QRect();
+    if (image.size() == size()) return content;
+    // Old-size frame from before a resize, drawn centered as a whole
+    return QRect(QPoint((width() - image.width()) / 2, (height() - image.height()) / 2), image.size());
+}
+
+void SlideshowWidget::showFrame(const Frame& frame) {
+    // Only where either picture is; the bars around both are black already
+    if (m_kenBurns) update();
+    else update(pictureRect(m_current.image, m_current.content) | pictureRect(frame.image, frame.content));
+    // Same slide, possibly re-decoded: its pan/zoom carries on
+    qint64 shownAt = m_current.shownAt;
+    m_current = frame;
+    m_current.shownAt = shownAt;
+}
+
+void SlideshowWidget::drawKenBurns(QPainter& p, const Frame& frame, qint64 now) const {
+    const QImage& top = frame.levels.first();
+    
+    // Progress over the slide's whole time on screen, fade in to fade out
+    double transitionMs = ConfigManager::instance().transitionTime() * 1000;
+    double lifeMs = 2 * transitionMs + ConfigManager::instance().slideDuration() * 1000;
+    double t = qBound(0.0, (now - frame.shownAt) / qMax(1.0, lifeMs), 1.0);
+    
+    // Path from the seed: zoom in or out, panning between opposite points
+    uint seed = frame.seed;
+    double zoomFrom = 1.0 + ((seed >> 1) & 0xff) / 255.0 * (kKenBurnsMaxZoom - 1.0 - kKenBurnsTravel);
+    double zoom = (seed & 1) ? zoomFrom + kKenBurnsTravel * t : zoomFrom + kKenBurnsTravel * (1.0 - t);
+    double fromX = ((seed >> 9) & 0xff) / 255.0;
+    double fromY = ((seed >> 17) & 0xff) / 255.0;
+    double panX = fromX + (1.0 - 2.0 * fromX) * t;
+    double panY = fromY + (1.0 - 2.0 * fromY) * t;
+    
+    // Visible region in top-level pixels: the view's shape, as large as fits, over zoom
+    QSizeF region = QSizeF(size()).scaled(QSizeF(top.size()), Qt::KeepAspectRatio) / zoom;
+    double x = (top.width() - region.width()) * panX;
+    double y = (top.height() - region.height()) * panY;
+    
+    // Level nearest 1:1 keeps bilinear sampling close to unscaled:
+    // no aliasing, and no more source memory touched than needed
+    double scale = width() / region.width();
+    int level = 0;
+    double best = std::abs(std::log(scale));
+    for (int i = 1; i < frame.levels.size(); i++) {
+        double off = std::abs(std::log(scale * top.width() / frame.levels[i].width()));
+        if (off < best) {
+            best = off;
+            level = i;
+        }
+    }
+    const QImage& src = frame.levels[level];
+    double factor = (double)src.width() / top.width();
+    
+    QTransform transform;
+    transform.scale(scale / factor, scale / factor);
+    transform.translate(-x * factor, -y * factor);
+    p.save();
+    p.setRenderHint(QPainter::SmoothPixmapTransform);
+    p.setTransform(transform);
+    p.drawImage(QPointF(0, 0), src);
+    p.restore();
 }
 
 void SlideshowWidget::updateAnimation() {
-    if (!m_isTransitioning) {
+    TRACE_SCOPE("slideshow.tick");
+    // Ken Burns keeps ticking between fades; a static slide doesn't
+    if (!m_isTransitioning && !m_kenBurns) {
         m_animationTimer->stop();
         return;
     }
     
-    double transitionTime = ConfigManager::instance().transitionTime();
-    double step = 0.016 / (transitionTime > 0 ? transitionTime : 0.016); // roughly
+    // Both pictures' area, taken before the swap below; a static slide gets
+    // no further ticks or paints
+    QRect dirty = pictureRect(m_current.image, m_current.content) | pictureRect(m_next.image, m_next.content);
+    
+    qint64 now = m_clock.elapsed();
+    int interval = m_animationTimer->interval();
+    qint64 gap = now - m_lastTickAt;
+    m_lastTickAt = now;
+    if (gap > interval * 3 / 2) {
+        // Late tick; anything past a whole extra slot was a dropped frame
+        m_fadeLate++;
+        m_fadeDropped += (int)(gap / interval) - 1;
+    }
     
-    m_opacity += step;
+    // From the clock, so late ticks don't stretch the fade
+    double transitionMs = ConfigManager::instance().transitionTime() * 1000;
+    if (m_isTransitioning) {
+        m_opacity = transitionMs > 0 ? qMin(1.0, (now - m_fadeStartedAt) / transitionMs) : 1.0;
+    }
     
-    if (m_opacity >= 1.0) {
+    if (m_isTransitioning && m_opacity >= 1.0) {
         m_opacity = 1.0;
         m_isTransitioning = false;
-        m_animationTimer->stop();
+        if (!m_kenBurns) m_animationTimer->stop();
+        
+        m_lateFrames += m_fadeLate;
+        m_droppedFrames += m_fadeDropped;
+        fadeDroppedFrames()->observe(m_fadeDropped);
         
         m_currentIndex = m_nextIndex;
-        m_currentImage = m_nextImage;
-        m_nextImage = QImage();
+        m_current = m_next;
+        m_next = Frame();
         m_nextIndex = -1;
         
         // Schedule next
         if (m_running && !m_paused) {
              m_slideTimer->start(ConfigManager::instance().slideDuration() * 1000);
         }
+        updatePrefetch();
     }
+    if (m_animationTimer->isActive()) adaptFrameInterval();
     
-    update();
+    if (m_kenBurns) update(); // Moving picture, whole screen
+    else update(dirty);
+}
+
+void SlideshowWidget::adaptFrameInterval() {
+    QScreen* screen = window()->windowHandle() ? window()->windowHandle()->screen() : nullptr;
+    if (!screen) screen = QGuiApplication::primaryScreen();
+    double refresh = screen ? screen->refreshRate() : 60.0;
+    if (refresh < 1.0) refresh = 60.0;
+    
+    // Ticking faster than frames can be rendered only turns into dropped
+    // frames; a 30 Hz panel never shows more than 30 either
+    double period = 1000.0 / refresh;
+    int frames = qMax(1, (int)std::ceil(m_renderMs * kRenderHeadroom / period));
+    int interval = qMax(1, qRound(period * frames));
+    if (interval != m_animationTimer->interval()) m_animationTimer->setInterval(interval);
 }
 
 void SlideshowWidget::paintEvent(QPaintEvent *event) {
+    TRACE_SCOPE("slideshow.paint");
+    QElapsedTimer cost;
+    cost.start();
     QPainter p(this);
-    p.fillRect(rect(), Qt::black); // Background
-    
-    if (m_currentImage.isNull()) return;
+    // Just what was invalidated: picture areas during a fade or slide
+    // change, the whole widget only after a resize or expose
+    QRect dirty = event->rect() & rect();
     
-    // Draw Current
-    // Center it
-    int x1 = (width() - m_currentImage.width()) / 2;
-    int y1 = (height() - m_currentImage.height()) / 2;
-    p.drawImage(x1, y1, m_currentImage);
-    
-    if (m_isTransitioning && !m_nextImage.isNull()) {
-        p.setOpacity(m_opacity);
-        int x2 = (width() - m_nextImage.width()) / 2;
-        int y2 = (height() - m_nextImage.height()) / 2;
-        p.drawImage(x2, y2, m_nextImage);
+    if (m_kenBurns && !m_current.levels.isEmpty()) {
+        // Always covers the widget: no bars, no background fill
+        qint64 now = m_clock.elapsed();
+        p.setCompositionMode(QPainter::CompositionMode_Source);
+        drawKenBurns(p, m_current, now);
+        if (m_isTransitioning && !m_next.levels.isEmpty()) {
+            p.setCompositionMode(QPainter::CompositionMode_SourceOver);
+            p.setOpacity(m_opacity);
+            drawKenBurns(p, m_next, now);
+        }
+    } else if (m_isTransitioning && blendFrames(dirty)) {
+        // Mid-fade: blended on the CPU into one frame, then blitted like a steady slide
+        p.setCompositionMode(QPainter::CompositionMode_Source);
+        p.drawImage(dirty, m_blendedImage, dirty);
+    } else {
+        // Frames come letterboxed at widget size, so a steady slide is one
+        // opaque blit. Anything else is left over from before a resize and is
+        // drawn the old way until its replacement arrives.
+        if (m_current.image.size() == size()) {
+            p.setCompositionMode(QPainter::CompositionMode_Source);
+            p.drawImage(dirty, m_current.image, dirty);
+            p.setCompositionMode(QPainter::CompositionMode_SourceOver);
+        } else {
+            p.fillRect(dirty, Qt::black); // Background
+            if (!m_current.image.isNull()) {
+                p.drawImage((width() - m_current.image.width()) / 2,
+                            (height() - m_current.image.height()) / 2, m_current.image);
+            }
+        }
+        
+        if (m_isTransitioning && !m_next.image.isNull()) {
+            p.setOpacity(m_opacity);
+            int x2 = (width() - m_next.image.width()) / 2;
+            int y2 = (height() - m_next.image.height()) / 2;
+            p.drawImage(x2, y2, m_next.image);
+        }
     }
+    
+    // Only animated frames count towards pacing: fades, and every Ken Burns frame
+    if (m_isTransitioning || (m_kenBurns && !m_current.levels.isEmpty())) m_renderMs = 0.8 * m_renderMs + 0.2 * (cost.nsecsElapsed() / 1e6);
 }
@@ -5,8 +5,12 @@
 #include <QImage>
 #include <QTimer>
 #include <QThread>
+#include <QHash>
+#include <QElapsedTimer>
 #include "ImageCacheLoader.h" 
 
+class QPainter;
+
 // Forward decl
 class SlideshowWidget : public QWidget {
     Q_OBJECT
@@ -15,6 +19,9 @@ public:
     ~SlideshowWidget();
 
     void setImagePaths(const QStringList& paths);
+    // Library changed under a running show: keeps the current slide (by path,
+    // following renames) and carries on with whatever came after it
+    void updateImagePaths(const QStringList& paths, const QHash<QString, QString>& renamed);
     void startSlideshow(int startIndex);
     void stopSlideshow();
     void nextSlide();
@@ -24,33 +31,101 @@ public:
     
     bool isRunning() const { return m_running; }
     bool isPaused() const { return m_paused; }
+    bool isTransitioning() const { return m_isTransitioning; }
+    
+    // Fade frame pacing, since startup
+    int lateFrames() const { return m_lateFrames; }       // Ticks well past their slot
+    int droppedFrames() const { return m_droppedFrames; } // Slots skipped entirely
 
 protected:
     void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
 
 private slots:
     void updateAnimation();
-    void onImageLoaded(QString path, QImage image);
+    void onImageLoaded(quint64 token, QString path, SlideFrame slide, int decodeMs);
+    void updatePrefetch();
 
 private:
+    // A decoded slide, plus what the widget tracks about it
+    struct Frame : SlideFrame {
+        QSize viewSize;  // Widget size it was decoded for
+        uint seed;       // Picks its pan/zoom path
+        qint64 shownAt;  // m_clock ms its fade-in began; drives pan/zoom
+    };
+
     void transitionToImage(int index);
+    void beginTransition(const Frame& frame);
+    void showFrame(const Frame& frame);
+    // Widget area a frame actually covers with picture; everything outside
+    // is black and never needs repainting once the bars are drawn
+    QRect pictureRect(const QImage& image, const QRect& content) const;
+    
+    // Ken Burns: draws the frame's pyramid level nearest 1:1 for where its
+    // pan/zoom is at `now`, through one scale+translate. Always fills the
+    // widget, so per-frame cost is one bilinear pass over the screen.
+    void drawKenBurns(QPainter& p, const Frame& frame, qint64 now) const;
+    
+    // Prefetch ring. Slides around the current one are decoded ahead, each
+    // requested early enough (by its learned decode time) to be ready when
+    // its transition is due.
+    int slideAfter(int index, int steps) const; // -1 past the end unless looping
+    int slideBefore(int index) const;
+    qint64 msUntilNextTransition() const; // -1 while nothing is scheduled
+    qint64 estimateDecodeMs(const QString& path) const;
+    void learnDecodeTime(const QString& path, int decodeMs);
+    // Token of the outstanding request, 0 if it's already in the ring
+    quint64 requestSlide(int index, ImageCacheLoader::Priority priority);
+    void cancelPending();
+    // Mixes current and next into m_blendedImage; false if they aren't
+    // both screen-ready frames (then QPainter's opacity path is used)
+    bool blendFrames(const QRect& area);
+    // Fade tick interval: the shortest multiple of the display's refresh
+    // period that covers what a frame has been costing to render
+    void adaptFrameInterval();
 
     QStringList m_paths;
     int m_currentIndex;
     int m_nextIndex;
     
-    QImage m_currentImage;
-    QImage m_nextImage;
-    QImage m_blendedImage; // If doing CPU blending
+    Frame m_current;
+    Frame m_next;
+    QImage m_blendedImage; // Fade output, widget-sized; reused every frame
     
     bool m_running;
     bool m_paused;
+    bool m_kenBurns; // Mode the ring was decoded for
     bool m_isTransitioning;
     float m_opacity; // 0.0 to 1.0 (0=current, 1=next)
     
     QTimer* m_animationTimer;
     QTimer* m_slideTimer;
     
+    // Fade progress comes from m_clock, not from counting ticks
+    qint64 m_fadeStartedAt;
+    qint64 m_pausedAt;
+    qint64 m_lastTickAt;
+    double m_renderMs;     // Moving average of animated paints
+    int m_fadeLate;
+    int m_fadeDropped;
+    int m_lateFrames;
+    int m_droppedFrames;
+    
+    struct PendingSlide {
+        quint64 token;
+        int priority;
+        qint64 estimateMs;
+    };
+    QHash<QString, Frame> m_ring;            // Path -> decoded, widget-sized
+    QHash<QString, PendingSlide> m_pending;  // Requested, not back yet
+    quint64 m_currentToken;                  // Current slide, when shown before it arrived
+    quint64 m_nextToken;                     // What a due transition is waiting on
+    QHash<QString, double> m_decodeMs;       // Path -> learned decode time
+    double m_msPerMB;                        // For files not decoded yet
+    QTimer* m_prefetchTimer;                 // Next time a request falls due
+    QElapsedTimer m_clock;
+    qint64 m_transitionDueAt;                // When the pending transition should have started
+    
     // Helper to load async?
     // For simplicity, we might load in main thread if performant enough or use a worker.
     // Given the "native app speed" requirement, we definitely want async loading.
@@ -0,0 +1,21 @@
+#ifndef SOCKETNOTIFIER_H
+#define SOCKETNOTIFIER_H
+
+#include <QSocketNotifier>
+
+namespace SocketNotifier {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+// activated() is overloaded from 5.15 on and both take the private tag, which
+// QOverload can't name; let deduction pick the QSocketDescriptor one
+template <typename Tag>
+constexpr auto pick(void (QSocketNotifier::*signal)(QSocketDescriptor, QSocketNotifier::Type, Tag)) {
+    return signal;
+}
+
+inline auto activated() { return pick(&QSocketNotifier::activated); }
+#else
+inline auto activated() { return &QSocketNotifier::activated; }
+#endif
+}
+
+#endif // SOCKETNOTIFIER_H
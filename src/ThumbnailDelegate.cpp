@@ -0,0 +1,50 @@
+#include "ThumbnailDelegate.h"
+#include <QPainter>
+#include <QPixmap>
+
+namespace {
+const int kPadding = 5;
+const QColor kSelectedColor(0x44, 0x44, 0x44);
+const QColor kTextColor(0xcc, 0xcc, 0xcc);
+}
+
+ThumbnailDelegate::ThumbnailDelegate(QObject* parent)
+    : QStyledItemDelegate(parent)
+{
+}
+
+void ThumbnailDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option,
+                              const QModelIndex& index) const {
+    painter->save();
+
+    if (option.state & QStyle::State_Selected) {
+        painter->fillRect(option.rect, kSelectedColor);
+    }
+
+    QSize iconSize = option.decorationSize;
+    QRect iconRect(option.rect.x() + (option.rect.width() - iconSize.width()) / 2,
+                   option.rect.y() + kPadding, iconSize.width(), iconSize.height());
+
+    QVariant decoration = index.data(Qt::DecorationRole);
+    if (decoration.isValid()) {
+        // Icons come composed at exactly this size and DPR
+        painter->drawPixmap(iconRect.topLeft(), decoration.value<QPixmap>());
+    } else {
+        painter->fillRect(iconRect, Qt::black);
+    }
+
+    QRect textRect(option.rect.x() + kPadding, iconRect.bottom() + kPadding,
+                   option.rect.width() - 2 * kPadding, option.fontMetrics.height());
+    QString name = option.fontMetrics.elidedText(index.data(Qt::DisplayRole).toString(),
+                                                 Qt::ElideMiddle, textRect.width());
+    painter->setPen(kTextColor);
+    painter->drawText(textRect, Qt::AlignHCenter | Qt::AlignTop, name);
+
+    painter->restore();
+}
+
+QSize ThumbnailDelegate::sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const {
+    Q_UNUSED(index);
+    // Same cell the zoom slider sets as the view's grid
+    return QSize(option.decorationSize.width() + 20, option.decorationSize.height() + 50);
+}
@@ -0,0 +1,18 @@
+#ifndef THUMBNAILDELEGATE_H
+#define THUMBNAILDELEGATE_H
+
+#include <QStyledItemDelegate>
+
+// Paints one grid cell: icon (or a flat placeholder while it loads) with the
+// file name underneath. Placeholders are a plain fill, no pixmap per cell.
+class ThumbnailDelegate : public QStyledItemDelegate {
+    Q_OBJECT
+public:
+    explicit ThumbnailDelegate(QObject* parent = nullptr);
+
+    void paint(QPainter* painter, const QStyleOptionViewItem& option,
+               const QModelIndex& index) const override;
+    QSize sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+};
+
+#endif // THUMBNAILDELEGATE_H
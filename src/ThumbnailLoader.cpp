@@ -4,15 +4,167 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QFile>
-#include <QCryptographicHash>
 #include <QFileInfo>
 #include <QImageReader>
 #include <QDateTime>
 #include <QDebug>
+#include <QRunnable>
+#include <QThread>
+#include <QPainter>
 #include "ConfigManager.h"
+#include "ThumbnailStore.h"
+#include "ExifThumbnail.h"
+#include "FastHash.h"
+#include "Trace.h"
+#include "Metrics.h"
+
+namespace {
+// Recently served thumbnails kept ready for page flips back and forth
+const int kDecodedCacheKB = 64 * 1024;
+
+// Delivery batching: at most one signal per display frame
+const int kBatchIntervalMs = 16;
+const int kProgressIntervalMs = 250;
+
+// Mipmap levels (longest edge). Each image is stored at one of them:
+// kBaseLevel, or bigger only when the zoom actually asks for it. Smaller
+// zooms shrink it while composing the icon.
+const int kThumbLevels[] = {64, 128, 256, 512};
+const int kBaseLevel = 256;
+
+QString levelKey(const QString& cacheKey, int level) {
+    return cacheKey + '@' + QString::number(level);
+}
+
+struct ThumbMetrics {
+    Metrics::Counter* hits;
+    Metrics::Counter* misses;
+    Metrics::Counter* evictions;
+    Metrics::Gauge* queueDepth;
+    Metrics::Gauge* cacheBytes;
+    Metrics::Gauge* cacheMaxBytes;
+};
+
+const ThumbMetrics& metrics() {
+    static const ThumbMetrics m = {
+        Metrics::counter("slideshow_thumbnail_cache_hits_total", "Thumbnails found in the disk cache"),
+        Metrics::counter("slideshow_thumbnail_cache_misses_total", "Thumbnails sent to the generator pool"),
+        Metrics::counter("slideshow_thumbnail_cache_evictions_total", "Thumbnails evicted to stay under cache_max_size_mb"),
+        Metrics::gauge("slideshow_thumbnail_queue_depth", "Thumbnail jobs queued or running on the generator pool"),
+        Metrics::gauge("slideshow_thumbnail_cache_bytes", "Live bytes in the thumbnail store"),
+        Metrics::gauge("slideshow_thumbnail_cache_max_bytes", "Limit for slideshow_thumbnail_cache_bytes (cache_max_size_mb)"),
+    };
+    return m;
+}
+
+qint64 maxCacheBytes() {
+    return (qint64)(ConfigManager::instance().cacheMaxSizeMB() * 1024 * 1024);
+}
+}
+
+int ThumbnailLoader::levelFor(int pixels) {
+    // Smallest level that still covers the request, so the view only ever
+    // shrinks a thumbnail, and by less than 2x
+    for (int level : kThumbLevels) {
+        if (level >= pixels) return level;
+    }
+    return kThumbLevels[sizeof(kThumbLevels) / sizeof(kThumbLevels[0]) - 1];
+}
+
+// Decodes and scales one thumbnail on a pool thread.
+// Never touches the loader's metadata; the result goes back through
+// finishGeneration() and is committed by process().
+class ThumbnailTask : public QRunnable {
+public:
+    ThumbnailTask(ThumbnailLoader* loader, int index, const QString& path,
+                  qint64 fileSize, qint64 mtime, int topLevel, int previewEdge)
+        : m_loader(loader), m_topLevel(topLevel), m_previewEdge(previewEdge)
+    {
+        m_result.index = index;
+        m_result.path = path;
+        m_result.lastModified = mtime;
+        m_result.fileSize = fileSize;
+        m_result.reused = false;
+        m_result.previewEdge = 0;
+    }
+
+    void run() override {
+        TRACE_SCOPE("thumbs.generate");
+        // Key by content: a moved file or a duplicate finds its thumbnail
+        // already stored and costs a few small reads instead of a decode
+        m_result.cacheKey = FastHash::fileKey(m_result.path, m_result.fileSize);
+        if (m_result.cacheKey.isEmpty()) {
+            m_loader->finishGeneration(m_result);
+            return;
+        }
+        if (m_loader->isKeyReusable(m_result.cacheKey, m_topLevel, m_previewEdge)) {
+            m_result.reused = true;
+            TRACE_INSTANT("thumbs.reused");
+            m_loader->finishGeneration(m_result);
+            return;
+        }
+
+        // Fast path: camera JPEGs usually carry a small embedded preview,
+        // good enough when the grid isn't zoomed in far
+        QString suffix = QFileInfo(m_result.path).suffix().toLower();
+        if (suffix == "jpg" || suffix == "jpeg") {
+            m_loader->m_exifAttempts.fetchAndAddRelaxed(1);
+            QImage preview = ExifThumbnail::read(m_result.path, m_previewEdge);
+            if (!preview.isNull()) {
+                m_loader->m_exifHits.fetchAndAddRelaxed(1);
+                m_result.previewEdge = qMax(preview.width(), preview.height());
+                buildLevels(preview);
+                m_loader->finishGeneration(m_result);
+                return;
+            }
+        }
+        
+        QImageReader reader(m_result.path);
+        reader.setAutoTransform(true); // Match the EXIF preview's orientation
+        
+        // Scale efficiently
+        QSize originalSize = reader.size();
+        if (originalSize.isValid()) {
+            // One decode at the top level, then each smaller level from the
+            // one above it
+            int dim = m_topLevel;
+            if (originalSize.width() > dim || originalSize.height() > dim) {
+                reader.setScaledSize(originalSize.scaled(dim, dim, Qt::KeepAspectRatio));
+            }
+            
+            QImage img = reader.read();
+            if (!img.isNull()) buildLevels(img);
+        }
+        
+        // Always report back, even on failure, so in-flight accounting stays right
+        m_loader->finishGeneration(m_result);
+    }
+
+private:
+    void buildLevels(QImage img) {
+        if (img.width() > m_topLevel || img.height() > m_topLevel) {
+            img = img.scaled(m_topLevel, m_topLevel, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        }
+        // Convert here so the store append is a plain memcpy. Photos are
+        // opaque: 3 bytes a pixel instead of 4.
+        img = img.convertToFormat(img.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied
+                                                        : QImage::Format_RGB888);
+        m_result.levels.insert(m_topLevel, img);
+    }
+
+private:
+    ThumbnailLoader* m_loader;
+    int m_topLevel;
+    int m_previewEdge; // Smallest embedded preview worth using
+    GeneratedThumbnail m_result;
+};
 
 ThumbnailLoader::ThumbnailLoader(QObject* parent) 
-    : QObject(parent), m_abort(false), m_pendingClear(false), m_currentPage(0), m_thumbsPerPage(20)
+    : QObject(parent), m_abort(false), m_pendingClear(false), m_visibleFirst(0), m_visibleLast(-1),
+      m_iconSize(150, 150), m_iconDpr(1.0), m_viewSerial(0), m_rangeSerial(0), m_pathsEdited(false), m_visibleStart(0), m_visibleEnd(-1),
+      m_iconPixels(150, 150), m_iconDprCopy(1.0), m_targetPixels(150), m_targetLevel(kBaseLevel),
+      m_cacheOpen(false), m_inFlight(0), m_generatedThisPass(0), m_generatedTotal(0), m_cachedTotal(0),
+      m_generatedBytes(0), m_cachedBytes(0), m_fillCache(false), m_thumbsPerSecond(0.0)
 {
     m_cacheDir = QStandardPaths::writableLocation(QStandardPaths::ConfigLocation) + "/Endless_Slides/thumbnails";
     m_metadataFile = m_cacheDir + "/cache_metadata.json";
@@ -21,13 +173,28 @@ ThumbnailLoader::ThumbnailLoader(QObject* parent)
     if (!dir.exists(m_cacheDir)) {
         dir.mkpath(m_cacheDir);
     }
+    m_store = new ThumbnailStore(m_cacheDir);
+    m_journal = new MetadataJournal(m_cacheDir);
     
-    loadCacheMetadata();
+    // One worker per core; keep a couple of jobs queued per worker so the
+    // pool never starves while process() is busy committing results.
+    m_pool.setMaxThreadCount(QThread::idealThreadCount());
+    m_maxInFlight = m_pool.maxThreadCount() * 2;
+    
+    m_decoded.setMaxCost(kDecodedCacheKB);
+    
+    qRegisterMetaType<ThumbnailResult>("ThumbnailResult");
+    qRegisterMetaType<QVector<ThumbnailResult>>("QVector<ThumbnailResult>");
+    qRegisterMetaType<ThumbnailProgress>("ThumbnailProgress");
 }
 
 ThumbnailLoader::~ThumbnailLoader() {
     stop();
-    saveCacheMetadata();
+    m_pool.clear();
+    m_pool.waitForDone();
+    if (m_cacheOpen) saveCacheMetadata();
+    delete m_journal;
+    delete m_store;
 }
 
 void ThumbnailLoader::stop() {
@@ -36,6 +203,202 @@ void ThumbnailLoader::stop() {
     m_condition.wakeOne();
 }
 
+void ThumbnailLoader::setWorkerCount(int workers) {
+    m_pool.setMaxThreadCount(qMax(1, workers));
+    m_maxInFlight = m_pool.maxThreadCount() * 2;
+}
+
+void ThumbnailLoader::setFillCache(bool fill) {
+    m_fillCache = fill;
+}
+
+double ThumbnailLoader::thumbnailsPerSecond() {
+    QMutexLocker locker(&m_mutex);
+    return m_thumbsPerSecond;
+}
+
+double ThumbnailLoader::exifHitRate() const {
+    int attempts = m_exifAttempts.loadAcquire();
+    return attempts > 0 ? (double)m_exifHits.loadAcquire() / attempts : 0.0;
+}
+
+void ThumbnailLoader::finishGeneration(const GeneratedThumbnail& result) {
+    // Runs on a pool thread
+    QMutexLocker locker(&m_resultMutex);
+    m_results.append(result);
+    m_resultReady.wakeOne();
+}
+
+int ThumbnailLoader::commitGenerated(bool block) {
+    TRACE_SCOPE("thumbs.commit");
+    QList<GeneratedThumbnail> results;
+    {
+        QMutexLocker locker(&m_resultMutex);
+        if (block && m_results.isEmpty() && m_inFlight > 0) {
+            if (m_batch.isEmpty()) {
+                m_resultReady.wait(&m_resultMutex);
+            } else {
+                // Don't sit on a pending batch past its frame
+                qint64 left = kBatchIntervalMs - m_batchTimer.elapsed();
+                m_resultReady.wait(&m_resultMutex, (unsigned long)qMax<qint64>(1, left));
+            }
+        }
+        results.swap(m_results);
+    }
+    
+    int generated = 0;
+    int reused = 0;
+    int retried = 0;
+    for (const GeneratedThumbnail& result : results) {
+        m_inFlight--;
+        metrics().queueDepth->add(-1);
+        
+        qint64 bytes = 0;
+        int previewEdge = result.previewEdge;
+        if (result.reused) {
+            // Evicted since the worker looked: leave it unchecked and count
+            // it as work, so the pass doesn't go idle before the next one
+            // generates it for real
+            auto key = m_keys.constFind(result.cacheKey); // Only this thread writes m_keys
+            if (key == m_keys.constEnd() || storedKey(result.cacheKey, kBaseLevel).isEmpty()) {
+                if (key != m_keys.constEnd()) {
+                    // Levels gone but the key still referenced: make workers decode
+                    QMutexLocker locker(&m_keyMutex);
+                    m_keys[result.cacheKey].topLevel = 0;
+                }
+                retried++;
+                continue;
+            }
+            bytes = key->bytes;
+            previewEdge = key->previewEdge;
+        }
+        
+        // Checked either way: an undecodable file is not retried every pass
+        m_checked.insert(result.path);
+        if (isVisible(result.index)) m_delivered.insert(result.index);
+        
+        if (!result.reused) {
+            if (result.levels.isEmpty()) continue;
+            
+            // Same key as any other copy of these bytes: replaces their levels too
+            for (int level : kThumbLevels) {
+                if (result.levels.contains(level)) continue;
+                m_store->remove(levelKey(result.cacheKey, level));
+                m_decoded.remove(levelKey(result.cacheKey, level));
+            }
+            for (auto it = result.levels.constBegin(); it != result.levels.constEnd(); ++it) {
+                QString key = levelKey(result.cacheKey, it.key());
+                bytes += m_store->insert(key, it.value());
+                m_decoded.remove(key);
+            }
+            if (bytes == 0) continue;
+            m_generatedBytes += bytes;
+        }
+        
+        CacheMetadata meta;
+        meta.lastModified = result.lastModified;
+        meta.fileSize = result.fileSize;
+        meta.lastAccess = QDateTime::currentMSecsSinceEpoch();
+        meta.cacheKey = result.cacheKey;
+        meta.sizeBytes = bytes;
+        meta.previewEdge = previewEdge;
+        
+        // Reused keys keep their levels as they are
+        int topLevel = result.reused ? 0 : result.levels.lastKey();
+        putMetadata(result.path, meta, topLevel);
+        if (result.reused) reused++;
+        else generated++;
+        
+        // Off-page results are only cached; the view has no slot for them
+        if (isVisible(result.index)) {
+            // Hand out the mapped copy so the decoded one can be freed
+            QString key = storedKey(result.cacheKey, m_targetLevel);
+            QImage img = key.isEmpty() ? QImage() : m_store->image(key);
+            if (!img.isNull()) {
+                rememberDecoded(key, img);
+                queueDelivery(result.index, result.path, img);
+            }
+        }
+    }
+    
+    flushDeliveries(false);
+    m_generatedThisPass += generated;
+    m_generatedTotal += generated;
+    if (!results.isEmpty()) metrics().cacheBytes->set(m_store->liveBytes());
+    return generated + reused + retried;
+}
+
+QImage ThumbnailLoader::composeIcon(const QImage& thumb) const {
+    // Ready to show: icon-sized, centered, premultiplied, at the grid's DPR
+    QImage canvas(m_iconPixels, QImage::Format_ARGB32_Premultiplied);
+    canvas.fill(Qt::transparent);
+    
+    // The stored level covers the icon; only small zooms shrink it by more than 2x
+    QImage fitted = thumb;
+    if (fitted.width() > m_iconPixels.width() || fitted.height() > m_iconPixels.height()) {
+        fitted = fitted.scaled(m_iconPixels, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+    
+    QPainter p(&canvas);
+    p.drawImage((canvas.width() - fitted.width()) / 2, (canvas.height() - fitted.height()) / 2, fitted);
+    p.end();
+    
+    canvas.setDevicePixelRatio(m_iconDprCopy);
+    return canvas;
+}
+
+void ThumbnailLoader::queueDelivery(int index, const QString& path, const QImage& thumb) {
+    if (m_batch.isEmpty()) m_batchTimer.start();
+    m_batch.append({index, path, composeIcon(thumb)});
+}
+
+void ThumbnailLoader::flushDeliveries(bool force) {
+    if (m_batch.isEmpty()) return;
+    if (!force && m_batchTimer.elapsed() < kBatchIntervalMs) return;
+    
+    emit thumbnailsReady(m_batch);
+    m_batch.clear();
+}
+
+bool ThumbnailLoader::isVisible(int index) const {
+    return index >= m_visibleStart && index <= m_visibleEnd;
+}
+
+void ThumbnailLoader::rememberDecoded(const QString& cacheKey, const QImage& img) {
+    // Cost in KiB keeps a few hundred MB well inside QCache's int range
+    int cost = qMax(1, (int)(img.sizeInBytes() / 1024));
+    m_decoded.insert(cacheKey, new QImage(img), cost);
+}
+
+bool ThumbnailLoader::deliverCached(int index, const QString& path) {
+    TRACE_SCOPE("thumbs.deliverCached");
+    auto it = m_metadata.find(path);
+    if (it == m_metadata.end()) return false;
+    
+    // Built from a preview too small for the current zoom: needs a real decode
+    if (it->previewEdge != 0 && it->previewEdge < m_targetPixels) return false;
+    
+    QString cacheKey = storedKey(it->cacheKey, m_targetLevel);
+    if (cacheKey.isEmpty()) return false;
+    QImage img;
+    if (QImage* hit = m_decoded.object(cacheKey)) {
+        img = *hit;
+    } else {
+        img = m_store->image(cacheKey);
+        if (img.isNull()) return false;
+        rememberDecoded(cacheKey, img);
+    }
+    
+    // Access times only feed LRU eviction; they ride along with
+    // the next checkpoint instead of costing a journal write each
+    it->lastAccess = QDateTime::currentMSecsSinceEpoch();
+    
+    queueDelivery(index, path, img);
+    flushDeliveries(false);
+    m_delivered.insert(index);
+    return true;
+}
+
 void ThumbnailLoader::requestClear() {
     QMutexLocker locker(&m_mutex);
     m_pendingClear = true;
@@ -45,22 +408,92 @@ void ThumbnailLoader::requestClear() {
 void ThumbnailLoader::setPaths(const QStringList& paths) {
     QMutexLocker locker(&m_mutex);
     m_paths = paths;
+    m_viewSerial++;
     m_condition.wakeOne();
 }
 
-void ThumbnailLoader::updatePriority(int page, int thumbsPerPage) {
+void ThumbnailLoader::appendPaths(const QStringList& paths) {
     QMutexLocker locker(&m_mutex);
-    m_currentPage = page;
-    m_thumbsPerPage = thumbsPerPage;
+    m_paths << paths;
+    m_rangeSerial++; // Re-plan to include them; delivered icons stay valid
+    m_condition.wakeOne();
+}
+
+void ThumbnailLoader::updatePaths(const QStringList& paths) {
+    QMutexLocker locker(&m_mutex);
+    if (!m_forgotten.isEmpty()) {
+        // Pending forgets were reported against the old rows
+        QHash<QString, int> rowOf;
+        rowOf.reserve(paths.size());
+        for (int i = 0; i < paths.size(); ++i) rowOf.insert(paths[i], i);
+        QSet<int> moved;
+        for (int index : m_forgotten) {
+            if (index < m_paths.size() && rowOf.contains(m_paths[index])) moved.insert(rowOf.value(m_paths[index]));
+        }
+        m_forgotten.swap(moved);
+    }
+    m_paths = paths;
+    m_pathsEdited = true;
+    m_rangeSerial++;
+    m_condition.wakeOne();
+}
+
+void ThumbnailLoader::invalidatePaths(const QStringList& paths) {
+    if (paths.isEmpty()) return;
+    QMutexLocker locker(&m_mutex);
+    for (const QString& path : paths) m_pathEdits.append(qMakePair(path, QString()));
+    m_rangeSerial++;
+    m_condition.wakeOne();
+}
+
+void ThumbnailLoader::renamePaths(const QList<QPair<QString, QString>>& renamed) {
+    if (renamed.isEmpty()) return;
+    QMutexLocker locker(&m_mutex);
+    m_pathEdits.append(renamed);
+    m_rangeSerial++;
+    m_condition.wakeOne();
+}
+
+void ThumbnailLoader::setVisibleRange(int first, int last) {
+    QMutexLocker locker(&m_mutex);
+    if (m_visibleFirst == first && m_visibleLast == last) return;
+    m_visibleFirst = first;
+    m_visibleLast = last;
+    m_rangeSerial++; // Re-prioritise; what the view already holds stays valid
+    m_condition.wakeOne();
+}
+
+void ThumbnailLoader::forgetDelivered(const QVector<int>& indices) {
+    QMutexLocker locker(&m_mutex);
+    for (int index : indices) m_forgotten.insert(index);
+}
+
+void ThumbnailLoader::setIconSize(const QSize& size, qreal devicePixelRatio) {
+    QMutexLocker locker(&m_mutex);
+    if (m_iconSize == size && m_iconDpr == devicePixelRatio) return;
+    m_iconSize = size;
+    m_iconDpr = devicePixelRatio;
+    m_viewSerial++;
     m_condition.wakeOne();
 }
 
 void ThumbnailLoader::process() {
     // This runs in the worker thread
+    openCache();
+    
+    int seenSerial = -1;
+    
     forever {
         QStringList pathsCopy;
-        int currentPage;
-        int thumbsPerPage;
+        int visibleFirst;
+        int visibleLast;
+        QSize iconPixels;
+        qreal iconDpr;
+        int serial;
+        int rangeSerial;
+        QSet<int> forgotten;
+        bool pathsEdited;
+        QList<QPair<QString, QString>> pathEdits;
         
         {
             QMutexLocker locker(&m_mutex);
@@ -81,182 +514,405 @@ void ThumbnailLoader::process() {
             }
             
             pathsCopy = m_paths;
-            currentPage = m_currentPage;
-            thumbsPerPage = m_thumbsPerPage;
+            visibleFirst = m_visibleFirst;
+            visibleLast = m_visibleLast;
+            iconPixels = m_iconSize * m_iconDpr;
+            iconDpr = m_iconDpr;
+            serial = m_viewSerial;
+            rangeSerial = m_rangeSerial;
+            forgotten.swap(m_forgotten);
+            pathsEdited = m_pathsEdited;
+            m_pathsEdited = false;
+            pathEdits.swap(m_pathEdits);
         }
         
+        applyPathEdits(pathEdits);
         if (pathsCopy.isEmpty()) continue;
 
-        // Prioritize current page
-        int startIdx = currentPage * thumbsPerPage;
-        int endIdx = qMin(startIdx + thumbsPerPage, pathsCopy.size());
+        // Prioritize the rows the view shows (plus its prefetch margin)
+        int startIdx = qBound(0, visibleFirst, pathsCopy.size() - 1);
+        int endIdx = qBound(-1, visibleLast, pathsCopy.size() - 1);
+        
+        // New view: it starts out with placeholders only
+        if (serial != seenSerial) {
+            seenSerial = serial;
+            m_delivered.clear();
+        } else {
+            if (pathsEdited) {
+                // Same view, edited list: follow delivered icons to their new rows
+                QHash<QString, int> rowOf;
+                rowOf.reserve(pathsCopy.size());
+                for (int i = 0; i < pathsCopy.size(); ++i) rowOf.insert(pathsCopy[i], i);
+                QSet<int> moved;
+                for (int index : m_delivered) {
+                    if (index < m_viewPaths.size() && rowOf.contains(m_viewPaths[index])) {
+                        moved.insert(rowOf.value(m_viewPaths[index]));
+                    }
+                }
+                m_delivered.swap(moved);
+            }
+            // Rows the view dropped icons for while scrolling
+            m_delivered.subtract(forgotten);
+        }
+        m_viewPaths = pathsCopy;
+        
+        // Rewritten files: the icon the view holds is stale
+        if (!pathEdits.isEmpty() && !m_delivered.isEmpty()) {
+            QSet<QString> stale;
+            for (const auto& edit : pathEdits) {
+                if (edit.second.isEmpty()) stale.insert(edit.first);
+            }
+            for (auto it = m_delivered.begin(); it != m_delivered.end(); ) {
+                if (*it < m_viewPaths.size() && stale.contains(m_viewPaths[*it])) it = m_delivered.erase(it);
+                else ++it;
+            }
+        }
+        m_visibleStart = startIdx;
+        m_visibleEnd = endIdx;
+        int targetSize = qMax(iconPixels.width(), iconPixels.height());
+        m_iconPixels = iconPixels;
+        m_iconDprCopy = iconDpr;
+        m_targetPixels = targetSize;
+        m_targetLevel = levelFor(targetSize);
+        int topLevel = qMax(kBaseLevel, m_targetLevel);
         
-        QList<int> priorityIndices;
-        // High priority: Current page
-        for (int i = startIdx; i < endIdx; ++i) priorityIndices << i;
+        QVector<int> priorityIndices;
+        priorityIndices.reserve(pathsCopy.size());
+        // High priority: Visible rows
+        for (int i = startIdx; i <= endIdx; ++i) priorityIndices << i;
         
-        // Low priority: Rest of the images
-        for (int i = 0; i < pathsCopy.size(); ++i) {
-            if (i < startIdx || i >= endIdx) priorityIndices << i;
+        // Low priority: The rest, nearest to the viewport first so scrolling
+        // in either direction runs into finished thumbnails
+        for (int d = 1; endIdx + d < pathsCopy.size() || startIdx - d >= 0; ++d) {
+            if (endIdx + d < pathsCopy.size()) priorityIndices << endIdx + d;
+            if (startIdx - d >= 0) priorityIndices << startIdx - d;
         }
 
         bool workDone = false;
+        bool viewChanged = false;
+        int walked = 0;
+        qint64 offScreenBudget = (qint64)(maxCacheBytes() * kCleanTarget);
+        auto reportProgress = [&]() {
+            m_progressTimer.start();
+            emit progress({walked, pathsCopy.size(), m_generatedTotal, m_cachedTotal, m_store->liveBytes(),
+                           m_generatedBytes, m_cachedBytes});
+        };
+        m_progressTimer.start();
         
         for (int idx : priorityIndices) {
             if (m_abort) break;
+            if (m_progressTimer.elapsed() >= kProgressIntervalMs) reportProgress();
+            walked++;
             
-            // Check if priority changed mid-loop
+            // Check if the view changed mid-loop
             {
                  QMutexLocker locker(&m_mutex);
-                 if (m_currentPage != currentPage || m_paths.size() != pathsCopy.size()) {
+                 if (m_viewSerial != serial || m_rangeSerial != rangeSerial || m_pendingClear) {
+                     viewChanged = true;
                      break; // Restart loop with new priority
                  }
             }
 
             QString path = pathsCopy[idx];
-            QString cachePath = getCacheFilePath(path);
+            bool visible = isVisible(idx);
+            
+            // Everything below is bookkeeping in memory until a file is
+            // unknown or a visible slot still has its placeholder
+            if (visible && m_delivered.contains(idx)) continue;
+            if (m_checked.contains(path)) {
+                if (!visible || deliverCached(idx, path)) continue;
+                m_checked.remove(path); // Evicted since; look again
+            }
+            
             QFileInfo fi(path);
             
-            if (!fi.exists()) continue; // File deleted?
+            if (!fi.exists()) { // File deleted?
+                m_checked.insert(path);
+                continue;
+            }
 
             qint64 mtime = fi.lastModified().toMSecsSinceEpoch();
+            qint64 fileSize = fi.size();
             bool cachedParamsMatch = false;
 
-            if (m_metadata.contains(path)) {
-                if (m_metadata[path].lastModified == mtime && QFile::exists(cachePath)) {
+            // The content key was computed when the thumbnail was made; while
+            // size and mtime match it still holds, so nothing is read here
+            auto meta = m_metadata.find(path);
+            if (meta != m_metadata.end()) {
+                bool covers = !visible || meta->previewEdge == 0 || meta->previewEdge >= targetSize;
+                bool same = meta->lastModified == mtime && (meta->fileSize < 0 || meta->fileSize == fileSize);
+                if (same && covers &&
+                    !storedKey(meta->cacheKey, visible ? m_targetLevel : kBaseLevel).isEmpty()) {
                     cachedParamsMatch = true;
+                    if (meta->fileSize < 0) {
+                        // Entry from an older version; fill in what it lacks
+                        CacheMetadata filled = *meta;
+                        filled.fileSize = fileSize;
+                        putMetadata(path, filled, 0);
+                    }
                 }
             }
 
             if (cachedParamsMatch) {
-                // Emit cached
-                 // We don't necessarily need to re-emit if the UI already has it, 
-                 // but for simplicity we rely on the UI to ignore duplicates or we could track emitted here.
-                 // For this robust impl, we load the cached file and emit.
-                 // Optimization: The UI passes a list of "needed" indices? 
-                 // For now, let's just create QImage and emit. 
-                 
-                 QImage img(cachePath);
-                 if (!img.isNull()) {
-                     emit thumbnailReady(idx, path, img);
-                     m_metadata[path].lastAccess = QDateTime::currentMSecsSinceEpoch();
-                 }
+                TRACE_INSTANT("thumbs.cacheHit");
+                metrics().hits->add();
+                m_cachedTotal++;
+                m_cachedBytes += meta->sizeBytes;
+                m_checked.insert(path);
+                if (visible) deliverCached(idx, path);
+                else if (m_fillCache) meta->lastAccess = QDateTime::currentMSecsSinceEpoch(); // Keep it ahead of other folders in the LRU
+            } else if (!visible && !m_fillCache && m_store->liveBytes() >= offScreenBudget) {
+                // A full cache only makes room for what's on screen; anything
+                // else would be evicted again by the next clean
+                continue;
             } else {
-                // Generate
-                QImageReader reader(path);
-                
-                // Scale efficiently
-                QSize originalSize = reader.size();
-                // Target size 150x150
-                if (originalSize.isValid()) {
-                    int dim = 300; // Match max slider zoom
-                   if (originalSize.width() > dim || originalSize.height() > dim) {
-                       reader.setScaledSize(originalSize.scaled(dim, dim, Qt::KeepAspectRatio));
-                   }
+                // Generate on the pool. Jobs are queued in priority order, so the
+                // current page still comes back first.
+                if (m_generatedThisPass == 0 && m_inFlight == 0) m_rateTimer.start();
+                m_pool.start(new ThumbnailTask(this, idx, path, fileSize, mtime, topLevel, targetSize));
+                m_inFlight++;
+                metrics().misses->add();
+                metrics().queueDepth->add(1);
                 
-                   QImage img = reader.read();
-                   if (!img.isNull()) {
-                       img.save(cachePath, "JPG", 85);
-                       
-                       CacheMetadata meta;
-                       meta.lastModified = mtime;
-                       meta.lastAccess = QDateTime::currentMSecsSinceEpoch();
-                       meta.cacheFile = cachePath;
-                       meta.sizeBytes = QFileInfo(cachePath).size();
-                       
-                       m_metadata[path] = meta;
-                       
-                       emit thumbnailReady(idx, path, img);
-                       workDone = true;
-                   }
+                // Bounded: block for results once enough jobs are queued
+                while (m_inFlight >= m_maxInFlight) {
+                    if (commitGenerated(true) > 0) workDone = true;
                 }
             }
             
-            // Small sleep to not hog CPU?
-            // Actually QThread::yieldCurrentThread() or generic sleep
-            // But we want it fast on Pi.
+            // Pick up anything that finished meanwhile without stalling the walk
+            if (commitGenerated(false) > 0) workDone = true;
+        }
+        
+        // Drain the pool before re-planning so results keep their index and
+        // metadata stays single-writer
+        while (m_inFlight > 0) {
+            if (commitGenerated(true) > 0) workDone = true;
+        }
+        flushDeliveries(true);
+        if (!viewChanged && !m_abort) reportProgress();
+        
+        if (m_generatedThisPass > 0) {
+            double secs = m_rateTimer.elapsed() / 1000.0;
+            double rate = secs > 0 ? m_generatedThisPass / secs : 0.0;
+            {
+                QMutexLocker locker(&m_mutex);
+                m_thumbsPerSecond = rate;
+            }
+            m_generatedThisPass = 0;
+        }
+        
+        // New thumbnails may have pushed the cache over budget
+        if (workDone) cleanCache();
+        
+        if (m_journal->needsCheckpoint(m_metadata.size())) {
+            saveCacheMetadata();
+        } else if (workDone) {
+            m_journal->sync(); // Once per pass rather than per record
         }
         
-        // If we finished the whole list or loop broke, wait again
-        if (!workDone) {
+        // Everything known and the view is complete: sleep until something
+        // changes instead of polling
+        if (!workDone && !viewChanged) {
+             emit idle(pathsCopy.size());
              QMutexLocker locker(&m_mutex);
-             if (!m_abort) m_condition.wait(&m_mutex, 1000); // verify cache cleanup periodically
-             
-             // Run cleanup occasionally
-             QMetaObject::invokeMethod(this, "cleanCache", Qt::QueuedConnection);
+             if (!m_abort && !m_pendingClear && m_viewSerial == serial &&
+                 m_rangeSerial == rangeSerial) {
+                 m_condition.wait(&m_mutex);
+             }
         }
     }
 }
 
-QString ThumbnailLoader::getCacheFilePath(const QString& path) {
-    QByteArray hash = QCryptographicHash::hash(path.toUtf8(), QCryptographicHash::Sha256);
-    return m_cacheDir + "/" + hash.toHex() + ".thumb";
+void ThumbnailLoader::openCache() {
+    // Runs on the loader thread so a big library never delays the window
+    if (m_cacheOpen) return;
+    
+    m_store->open();
+    loadCacheMetadata();
+    rebuildKeys();
+    m_cacheOpen = true;
+    metrics().cacheBytes->set(m_store->liveBytes());
+    metrics().cacheMaxBytes->set(maxCacheBytes());
+    
+    // One-off migration from the old one-JPEG-per-thumbnail layout
+    QDir dir(m_cacheDir);
+    for (const QString& file : dir.entryList({"*.thumb"}, QDir::Files)) {
+        dir.remove(file);
+    }
 }
 
 void ThumbnailLoader::loadCacheMetadata() {
-     QFile f(m_metadataFile);
-     if (f.open(QIODevice::ReadOnly)) {
-         QJsonDocument doc = QJsonDocument::fromJson(f.readAll());
-         QJsonObject root = doc.object();
-         for (auto it = root.begin(); it != root.end(); ++it) {
-             QJsonObject obj = it.value().toObject();
-             CacheMetadata meta;
-             meta.lastModified = (qint64)obj["last_modified"].toDouble();
-             meta.sizeBytes = (qint64)obj["size_bytes"].toDouble();
-             meta.lastAccess = (qint64)obj["last_access"].toDouble();
-             meta.cacheFile = obj["cache_file"].toString();
-             m_metadata[it.key()] = meta;
-         }
-     }
+    if (m_journal->load(m_metadata)) return;
+    
+    // First start after an upgrade: import the old JSON once
+    QFile f(m_metadataFile);
+    if (f.open(QIODevice::ReadOnly)) {
+        QJsonDocument doc = QJsonDocument::fromJson(f.readAll());
+        QJsonObject root = doc.object();
+        for (auto it = root.begin(); it != root.end(); ++it) {
+            QJsonObject obj = it.value().toObject();
+            CacheMetadata meta;
+            meta.lastModified = (qint64)obj["last_modified"].toDouble();
+            meta.fileSize = -1;
+            meta.sizeBytes = (qint64)obj["size_bytes"].toDouble();
+            meta.lastAccess = (qint64)obj["last_access"].toDouble();
+            meta.cacheKey = obj["cache_key"].toString();
+            meta.previewEdge = 0;
+            m_metadata[it.key()] = meta;
+        }
+        f.close();
+        
+        saveCacheMetadata();
+        QFile::remove(m_metadataFile);
+    }
 }
 
 void ThumbnailLoader::saveCacheMetadata() {
-    QJsonObject root;
-    for (auto it = m_metadata.begin(); it != m_metadata.end(); ++it) {
-        QJsonObject obj;
-        obj["last_modified"] = (double)it.value().lastModified;
-        obj["size_bytes"] = (double)it.value().sizeBytes;
-        obj["last_access"] = (double)it.value().lastAccess;
-        obj["cache_file"] = it.value().cacheFile;
-        root[it.key()] = obj;
-    }
+    TRACE_SCOPE("thumbs.saveMetadata");
+    // Full snapshot; also folds the journal away
+    m_journal->checkpoint(m_metadata);
+}
+
+void ThumbnailLoader::putMetadata(const QString& path, const CacheMetadata& meta, int topLevel) {
+    // Take the new reference before dropping the old one: same key, no churn
+    retainKey(meta, topLevel);
+    auto old = m_metadata.constFind(path);
+    if (old != m_metadata.constEnd()) releaseKey(old->cacheKey);
     
-    QFile f(m_metadataFile);
-    if (f.open(QIODevice::WriteOnly)) {
-        f.write(QJsonDocument(root).toJson());
+    m_metadata[path] = meta;
+    m_journal->recordPut(path, meta);
+}
+
+void ThumbnailLoader::removeMetadata(const QString& path) {
+    auto it = m_metadata.find(path);
+    if (it == m_metadata.end()) return;
+    QString cacheKey = it->cacheKey;
+    m_metadata.erase(it);
+    m_journal->recordRemove(path);
+    releaseKey(cacheKey);
+}
+
+void ThumbnailLoader::rebuildKeys() {
+    QMutexLocker locker(&m_keyMutex);
+    m_keys.clear();
+    for (auto it = m_metadata.constBegin(); it != m_metadata.constEnd(); ++it) {
+        KeyInfo& info = m_keys[it->cacheKey];
+        if (info.refs++ > 0) continue;
+        info.previewEdge = it->previewEdge;
+        info.bytes = it->sizeBytes;
+        info.topLevel = 0;
+        for (int level : kThumbLevels) {
+            if (m_store->contains(levelKey(it->cacheKey, level))) info.topLevel = level;
+        }
+    }
+}
+
+void ThumbnailLoader::retainKey(const CacheMetadata& meta, int topLevel) {
+    QMutexLocker locker(&m_keyMutex);
+    auto it = m_keys.find(meta.cacheKey);
+    if (it == m_keys.end()) {
+        it = m_keys.insert(meta.cacheKey, KeyInfo());
+        it->refs = 0;
+        it->topLevel = 0;
+    }
+    it->refs++;
+    if (topLevel > 0) {
+        // Levels were just (re)written for every path sharing the key
+        it->topLevel = topLevel;
+        it->previewEdge = meta.previewEdge;
+        it->bytes = meta.sizeBytes;
+    }
+}
+
+void ThumbnailLoader::releaseKey(const QString& cacheKey) {
+    {
+        QMutexLocker locker(&m_keyMutex);
+        auto it = m_keys.find(cacheKey);
+        if (it == m_keys.end()) return;
+        if (--it->refs > 0) return; // Another copy of the file still uses it
+        m_keys.erase(it);
+    }
+    dropLevels(cacheKey);
+}
+
+QString ThumbnailLoader::storedKey(const QString& cacheKey, int minLevel) const {
+    // Loader thread only; it is the one writer of m_keys
+    auto it = m_keys.constFind(cacheKey);
+    if (it == m_keys.constEnd() || it->topLevel < minLevel) return QString();
+    QString key = levelKey(cacheKey, it->topLevel);
+    return m_store->contains(key) ? key : QString();
+}
+
+bool ThumbnailLoader::isKeyReusable(const QString& cacheKey, int topLevel, int minPreviewEdge) {
+    // Runs on pool threads
+    QMutexLocker locker(&m_keyMutex);
+    auto it = m_keys.constFind(cacheKey);
+    if (it == m_keys.constEnd()) return false;
+    return it->topLevel >= topLevel && (it->previewEdge == 0 || it->previewEdge >= minPreviewEdge);
+}
+
+void ThumbnailLoader::dropLevels(const QString& cacheKey) {
+    for (int level : kThumbLevels) {
+        m_store->remove(levelKey(cacheKey, level));
+        m_decoded.remove(levelKey(cacheKey, level));
+    }
+}
+
+void ThumbnailLoader::evictPath(const QString& path) {
+    // Levels go with the last path that uses them
+    m_checked.remove(path);
+    removeMetadata(path);
+}
+
+void ThumbnailLoader::applyPathEdits(const QList<QPair<QString, QString>>& edits) {
+    for (const auto& edit : edits) {
+        if (edit.second.isEmpty()) {
+            evictPath(edit.first);
+            continue;
+        }
+        
+        // Rename: same bytes, same key, same thumbnail
+        if (edit.first == edit.second) continue;
+        m_checked.remove(edit.first);
+        m_checked.remove(edit.second);
+        if (!m_metadata.contains(edit.first)) continue;
+        CacheMetadata meta = m_metadata.value(edit.first);
+        putMetadata(edit.second, meta, 0); // Replaces whatever was there
+        removeMetadata(edit.first);
     }
 }
 
 void ThumbnailLoader::cleanCache() {
-    double maxMB = ConfigManager::instance().cacheMaxSizeMB();
-    qint64 maxBytes = (qint64)(maxMB * 1024 * 1024);
+    TRACE_SCOPE("thumbs.cleanCache");
+    qint64 maxBytes = maxCacheBytes();
+    metrics().cacheMaxBytes->set(maxBytes);
     
-    qint64 currentBytes = 0;
-    QList<QPair<qint64, QString>> items; // lastAccess, key
+    // Counted in the store: duplicates share their bytes
+    if (m_store->liveBytes() <= maxBytes) return;
     
+    QList<QPair<qint64, QString>> items; // lastAccess, path
     for (auto it = m_metadata.begin(); it != m_metadata.end(); ++it) {
-        currentBytes += it.value().sizeBytes;
         items.append(qMakePair(it.value().lastAccess, it.key()));
     }
     
-    if (currentBytes <= maxBytes) return;
-    
     // Sort by LRU (oldest access first)
     std::sort(items.begin(), items.end(), [](const auto& a, const auto& b){
         return a.first < b.first;
     });
     
     for (const auto& item : items) {
-        if (currentBytes <= maxBytes * 0.9) break; // Clean down to 90%
-        
-        QString key = item.second;
-        QString file = m_metadata[key].cacheFile;
-        
-        if (QFile::remove(file)) {
-            currentBytes -= m_metadata[key].sizeBytes;
-            m_metadata.remove(key);
-        }
+        if (m_store->liveBytes() <= maxBytes * kCleanTarget) break;
+        // Stays checked: off screen it isn't made again only to be evicted
+        // again. Scrolled into view, deliverCached() misses and it is.
+        removeMetadata(item.second);
+        m_checked.insert(item.second);
+        metrics().evictions->add();
     }
+    
+    // Reclaim segments that eviction left mostly dead
+    m_store->compact();
+    metrics().cacheBytes->set(m_store->liveBytes());
 }
 
 void ThumbnailLoader::clearCache() {
@@ -272,7 +928,8 @@ void ThumbnailLoader::clearCache() {
     // However, cleanCache() slot might run? No, loop blocks slots.
     // So we are sole owner of m_metadata here.
     
-    // Robust clear: Delete all files in directory
+    // Segments go first, then anything else left in the directory
+    m_store->clear();
     QDir dir(m_cacheDir);
     QStringList files = dir.entryList(QDir::Files | QDir::NoDotAndDotDot);
     for (const QString &file : files) {
@@ -280,6 +937,14 @@ void ThumbnailLoader::clearCache() {
     }
     
     m_metadata.clear();
+    {
+        QMutexLocker locker(&m_keyMutex);
+        m_keys.clear();
+    }
+    m_decoded.clear();
+    m_checked.clear();
+    m_delivered.clear();
     saveCacheMetadata();
+    metrics().cacheBytes->set(m_store->liveBytes());
     emit cacheCleared();
 }
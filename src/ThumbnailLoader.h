@@ -7,14 +7,53 @@
 #include <QImage>
 #include <QMap>
 #include <QSet>
+#include <QHash>
 #include <QStringList>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QCache>
+#include <QAtomicInt>
+#include <QVector>
+#include <QSize>
+#include <QMetaType>
+#include <QPair>
+#include "MetadataJournal.h"
 
-struct CacheMetadata {
+class ThumbnailStore;
+
+// Result of one generation job, handed from a pool worker back to process()
+struct GeneratedThumbnail {
+    int index;
+    QString path;
+    QString cacheKey; // Content key, empty if the file couldn't be read
     qint64 lastModified;
-    qint64 sizeBytes;
-    qint64 lastAccess;
-    QString cacheFile;
+    qint64 fileSize;
+    bool reused; // Key already in the store (moved file or duplicate): nothing decoded
+    int previewEdge; // Non-zero if built from the embedded EXIF preview
+    QMap<int, QImage> levels; // Mipmap level -> image, empty on failure or reuse
+};
+
+// One grid icon, composed off the GUI thread
+struct ThumbnailResult {
+    int index;
+    QString path;
+    QImage icon; // Icon-sized, centered, premultiplied, DPR set
+};
+Q_DECLARE_METATYPE(ThumbnailResult)
+
+// Where the loader is in its walk over the library
+struct ThumbnailProgress {
+    int walked;        // Paths looked at this pass
+    int total;         // Paths in the pass
+    int generated;     // Thumbnails made since the loader started
+    int cached;        // Paths found already cached, since the loader started
+    qint64 cacheBytes; // Thumbnail store size
+    qint64 generatedBytes; // Stored for `generated`
+    qint64 cachedBytes;    // Held by `cached` (a duplicate counts once per path)
 };
+Q_DECLARE_METATYPE(ThumbnailProgress)
+
+class ThumbnailTask;
 
 class ThumbnailLoader : public QObject {
     Q_OBJECT
@@ -23,35 +62,154 @@ public:
     ~ThumbnailLoader();
 
     void setPaths(const QStringList& paths);
-    void updatePriority(int page, int thumbsPerPage);
+    // Streaming scans: indices of existing paths stay valid
+    void appendPaths(const QStringList& paths);
+    // Library edits: icons the view holds stay delivered if their path survived
+    void updatePaths(const QStringList& paths);
+    // Files deleted or rewritten: drop their thumbnails
+    void invalidatePaths(const QStringList& paths);
+    // Files moved: their thumbnails move with them
+    void renamePaths(const QList<QPair<QString, QString>>& renamed);
+    // Rows the grid shows (inclusive); served first, the rest outward from them
+    void setVisibleRange(int first, int last);
+    // Rows whose icons the grid dropped; served again when they come back
+    void forgetDelivered(const QVector<int>& indices);
+    // Icon size of the grid (logical) and its DPR; picks the mipmap level
+    // served and the size icons are composed at
+    void setIconSize(const QSize& size, qreal devicePixelRatio);
     void requestClear();
     void stop();
+    // Generator threads; call before the loader thread starts
+    void setWorkerCount(int workers);
+    // Headless pre-warm: rows off screen are generated past the clean-down
+    // mark too, evicting the least recently used entries. Cache hits count
+    // as a use. Call before the loader thread starts.
+    void setFillCache(bool fill);
+
+    // Eviction cleans the store down to this share of cache_max_size_mb
+    static constexpr double kCleanTarget = 0.9;
+
+    // Generation throughput of the last pass that produced new thumbnails
+    double thumbnailsPerSecond();
+    // Share of JPEGs served from their embedded EXIF preview
+    double exifHitRate() const;
 
 signals:
-    void thumbnailReady(int index, QString path, QImage image);
+    // Batched, at most one per frame interval
+    void thumbnailsReady(QVector<ThumbnailResult> results);
     void cacheCleared();
+    // Throttled, plus once at the end of every pass
+    void progress(ThumbnailProgress progress);
+    // A pass over `paths` paths found nothing left to generate
+    void idle(int paths);
 
 public slots:
     void process();
     void cleanCache();
 
 private:
+    friend class ThumbnailTask;
+
     void clearCache(); // moved to private helper
+    void openCache();
     void loadCacheMetadata();
     void saveCacheMetadata();
-    QString getCacheFilePath(const QString& path);
+    // topLevel: largest level just stored under meta.cacheKey, 0 if none were
+    void putMetadata(const QString& path, const CacheMetadata& meta, int topLevel);
+    void removeMetadata(const QString& path);
+    void dropLevels(const QString& cacheKey);
+    void evictPath(const QString& path);
+    void applyPathEdits(const QList<QPair<QString, QString>>& edits);
+
+    // Content keys are shared by every path with the same bytes, so levels
+    // are reference counted and only dropped with the last path using them.
+    // Workers read this to skip decoding files whose key is already stored.
+    struct KeyInfo {
+        int refs;
+        int topLevel;    // Mipmap level stored (largest, for caches from before one per key)
+        int previewEdge; // As in CacheMetadata
+        qint64 bytes;    // All levels together
+    };
+    void rebuildKeys();
+    void retainKey(const CacheMetadata& meta, int topLevel);
+    void releaseKey(const QString& cacheKey);
+    bool isKeyReusable(const QString& cacheKey, int topLevel, int minPreviewEdge);
+    // Store key of the level kept for cacheKey if it covers minLevel, else empty
+    QString storedKey(const QString& cacheKey, int minLevel) const;
+
+    // Generation pool. Workers only decode and scale; process() is the
+    // single writer of m_metadata and the store, and commits their results.
+    void finishGeneration(const GeneratedThumbnail& result);
+    int commitGenerated(bool block);
+
+    // Serving. The loader remembers which slots of the current view were
+    // filled and which paths are known to be cached, so an idle, fully
+    // cached library costs no disk I/O and no signals.
+    static int levelFor(int pixels);
+    bool isVisible(int index) const;
+    bool deliverCached(int index, const QString& path);
+    void rememberDecoded(const QString& cacheKey, const QImage& img);
+    QImage composeIcon(const QImage& thumb) const;
+    void queueDelivery(int index, const QString& path, const QImage& thumb);
+    void flushDeliveries(bool force);
 
     QMutex m_mutex;
     QWaitCondition m_condition;
     bool m_abort;
     bool m_pendingClear;
     QStringList m_paths;
-    int m_currentPage;
-    int m_thumbsPerPage;
+    int m_visibleFirst;
+    int m_visibleLast;
+    QSize m_iconSize;
+    qreal m_iconDpr;
+    int m_viewSerial; // Bumped whenever the grid drops all its icons
+    int m_rangeSerial; // Bumped when the visible range moves
+    QSet<int> m_forgotten;
+    bool m_pathsEdited; // m_paths was replaced by updatePaths()
+    QList<QPair<QString, QString>> m_pathEdits; // (from, to); empty "to" = invalidate
+    
+    // Loader-thread only
+    QStringList m_viewPaths; // Path list of the last pass
+    int m_visibleStart; // Inclusive
+    int m_visibleEnd;
+    QSize m_iconPixels;
+    qreal m_iconDprCopy;
+    int m_targetPixels;
+    int m_targetLevel;
+    QVector<ThumbnailResult> m_batch;
+    QElapsedTimer m_batchTimer;
+    QSet<int> m_delivered;            // Indices the current view already received
+    QSet<QString> m_checked;          // Paths verified against the cache this session
+    QCache<QString, QImage> m_decoded; // Cache key -> image, cost in KiB
     
     QMap<QString, CacheMetadata> m_metadata; // Path -> Metadata
+    QMutex m_keyMutex; // Guards m_keys; written by process(), read by workers
+    QHash<QString, KeyInfo> m_keys;
     QString m_cacheDir;
-    QString m_metadataFile;
+    QString m_metadataFile; // Legacy JSON, imported once
+    MetadataJournal* m_journal;
+    ThumbnailStore* m_store;
+    bool m_cacheOpen; // Store and metadata are opened lazily on the loader thread
+
+    QThreadPool m_pool;
+    int m_maxInFlight;
+    int m_inFlight; // only touched by process()
+
+    QMutex m_resultMutex;
+    QWaitCondition m_resultReady;
+    QList<GeneratedThumbnail> m_results;
+
+    QElapsedTimer m_rateTimer;
+    QElapsedTimer m_progressTimer;
+    int m_generatedThisPass;
+    int m_generatedTotal;
+    int m_cachedTotal;
+    qint64 m_generatedBytes;
+    qint64 m_cachedBytes;
+    bool m_fillCache;
+    double m_thumbsPerSecond;
+    QAtomicInt m_exifAttempts;
+    QAtomicInt m_exifHits;
 };
 
 #endif // THUMBNAILLOADER_H
@@ -0,0 +1,114 @@
+#include "ThumbnailModel.h"
+
+ThumbnailModel::ThumbnailModel(QObject* parent)
+    : QAbstractListModel(parent)
+{
+}
+
+int ThumbnailModel::rowCount(const QModelIndex& parent) const {
+    if (parent.isValid()) return 0;
+    return m_paths.size();
+}
+
+QVariant ThumbnailModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || index.row() >= m_paths.size()) return QVariant();
+
+    const QString& path = m_paths[index.row()];
+    switch (role) {
+    case Qt::DisplayRole:
+        return path.section('/', -1);
+    case Qt::DecorationRole: {
+        // No placeholder pixmap: the delegate paints the empty slot itself
+        auto it = m_icons.constFind(index.row());
+        if (it != m_icons.constEnd()) return it.value();
+        return QVariant();
+    }
+    case Qt::ToolTipRole:
+    case PathRole:
+        return path;
+    default:
+        return QVariant();
+    }
+}
+
+void ThumbnailModel::setPaths(const QStringList& paths) {
+    beginResetModel();
+    m_paths = paths;
+    m_icons.clear();
+    endResetModel();
+}
+
+void ThumbnailModel::insertPaths(const QStringList& paths) {
+    int row = 0;
+    while (row < paths.size()) {
+        if (row < m_paths.size() && m_paths[row] == paths[row]) {
+            row++;
+            continue;
+        }
+        // Everything up to the next existing row is new
+        int end = row;
+        while (end < paths.size() && (row >= m_paths.size() || paths[end] != m_paths[row])) end++;
+        int count = end - row;
+
+        beginInsertRows(QModelIndex(), row, end - 1);
+        m_paths.reserve(m_paths.size() + count);
+        for (int i = row; i < end; ++i) m_paths.insert(i, paths[i]);
+        if (!m_icons.isEmpty()) {
+            QHash<int, QPixmap> shifted;
+            for (auto it = m_icons.constBegin(); it != m_icons.constEnd(); ++it) {
+                shifted.insert(it.key() >= row ? it.key() + count : it.key(), it.value());
+            }
+            m_icons.swap(shifted);
+        }
+        endInsertRows();
+        row = end;
+    }
+}
+
+void ThumbnailModel::updatePaths(const QStringList& paths) {
+    QHash<QString, QPixmap> iconOf;
+    for (auto it = m_icons.constBegin(); it != m_icons.constEnd(); ++it) {
+        iconOf.insert(m_paths[it.key()], it.value());
+    }
+
+    beginResetModel();
+    m_paths = paths;
+    m_icons.clear();
+    if (!iconOf.isEmpty()) {
+        for (int row = 0; row < m_paths.size(); ++row) {
+            auto it = iconOf.constFind(m_paths[row]);
+            if (it != iconOf.constEnd()) m_icons.insert(row, it.value());
+        }
+    }
+    endResetModel();
+}
+
+void ThumbnailModel::setIcon(int row, const QString& path, const QPixmap& icon) {
+    // The loader may still be answering for an older path list
+    if (row < 0 || row >= m_paths.size() || m_paths[row] != path) return;
+
+    m_icons.insert(row, icon);
+    QModelIndex idx = index(row);
+    emit dataChanged(idx, idx, {Qt::DecorationRole});
+}
+
+void ThumbnailModel::clearIcons() {
+    if (m_icons.isEmpty()) return;
+    m_icons.clear();
+    if (!m_paths.isEmpty()) {
+        emit dataChanged(index(0), index(m_paths.size() - 1), {Qt::DecorationRole});
+    }
+}
+
+QVector<int> ThumbnailModel::evictIconsOutside(int first, int last) {
+    QVector<int> evicted;
+    for (auto it = m_icons.begin(); it != m_icons.end(); ) {
+        if (it.key() < first || it.key() > last) {
+            evicted.append(it.key());
+            it = m_icons.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return evicted;
+}
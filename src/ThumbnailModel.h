@@ -0,0 +1,44 @@
+#ifndef THUMBNAILMODEL_H
+#define THUMBNAILMODEL_H
+
+#include <QAbstractListModel>
+#include <QStringList>
+#include <QHash>
+#include <QPixmap>
+#include <QVector>
+
+// Flat model over the whole library. Rows are just indices into the path
+// list; icons exist only for rows near the viewport and are dropped again
+// as the user scrolls away.
+class ThumbnailModel : public QAbstractListModel {
+    Q_OBJECT
+public:
+    enum Roles {
+        PathRole = Qt::UserRole
+    };
+
+    explicit ThumbnailModel(QObject* parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+    void setPaths(const QStringList& paths);
+    // paths is the current list plus new rows anywhere in it; inserted run
+    // by run so the view keeps its scroll position and selection
+    void insertPaths(const QStringList& paths);
+    // Library edits: like setPaths, but icons follow their path to its new row
+    void updatePaths(const QStringList& paths);
+    const QStringList& paths() const { return m_paths; }
+
+    void setIcon(int row, const QString& path, const QPixmap& icon);
+    void clearIcons();
+
+    // Drops icons outside [first, last]; returns the rows that lost theirs
+    QVector<int> evictIconsOutside(int first, int last);
+
+private:
+    QStringList m_paths;
+    QHash<int, QPixmap> m_icons;
+};
+
+#endif // THUMBNAILMODEL_H
@@ -0,0 +1,321 @@
+#include "ThumbnailStore.h"
+#include <QDir>
+#include <QDebug>
+#include <cstring>
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+const quint32 kSegmentMagic = 0x53544e53; // "SNTS"
+const quint32 kSegmentVersion = 1;
+const quint32 kRecordMagic = 0x424d4854;  // "THMB"
+const quint32 kRecordDead = 0x1;
+const qint64 kSegmentCapacity = 64 * 1024 * 1024; // Sparse on disk, mapped once
+const qint64 kAlign = 64;
+
+struct SegmentHeader {
+    quint32 magic;
+    quint32 version;
+    quint8 reserved[56];
+};
+
+// Record layout: header | key (utf8) | pad | pixels | pad, all 64-byte aligned
+struct RecordHeader {
+    quint32 magic;
+    quint32 flags;
+    quint32 width;
+    quint32 height;
+    quint32 bytesPerLine;
+    quint32 format;
+    quint32 keyLength;
+    quint32 dataOffset; // from record start
+    quint64 recordSize;
+    quint8 reserved[24];
+};
+
+static_assert(sizeof(SegmentHeader) == kAlign, "segment header must stay one cache line");
+static_assert(sizeof(RecordHeader) == kAlign, "record header must stay one cache line");
+
+qint64 alignUp(qint64 v) {
+    return (v + kAlign - 1) & ~(kAlign - 1);
+}
+
+// Writes [offset, offset + length) of a segment mapping through to disk.
+// Dirty pages can otherwise reach the disk in any order on a power cut.
+bool syncRange(uchar* data, qint64 offset, qint64 length) {
+#ifdef Q_OS_UNIX
+    static const qint64 page = ::sysconf(_SC_PAGESIZE);
+    qint64 start = offset & ~(page - 1); // The mapping itself starts page-aligned
+    return ::msync(data + start, offset + length - start, MS_SYNC) == 0;
+#else
+    Q_UNUSED(data); Q_UNUSED(offset); Q_UNUSED(length);
+    return true;
+#endif
+}
+
+// QImage cleanup hook: drops the image's reference on its segment
+void releaseSegment(void* info) {
+    delete static_cast<QSharedPointer<void>*>(info);
+}
+}
+
+ThumbnailStore::Segment::~Segment() {
+    if (data) file.unmap(data);
+    file.close();
+}
+
+ThumbnailStore::ThumbnailStore(const QString& dir)
+    : m_dir(dir), m_liveBytes(0), m_activeSegment(-1)
+{
+}
+
+ThumbnailStore::~ThumbnailStore() {
+    // Segments still referenced by live QImages stay mapped until those go away
+}
+
+QString ThumbnailStore::segmentPath(int id) const {
+    return m_dir + QString("/segment_%1.pack").arg(id, 5, 10, QChar('0'));
+}
+
+ThumbnailStore::SegmentPtr ThumbnailStore::openSegment(int id, qint64 createCapacity) {
+    SegmentPtr seg(new Segment);
+    seg->id = id;
+    seg->file.setFileName(segmentPath(id));
+    if (!seg->file.open(QIODevice::ReadWrite)) return SegmentPtr();
+
+    if (createCapacity > 0) {
+        if (!seg->file.resize(createCapacity)) return SegmentPtr();
+    }
+
+    seg->capacity = seg->file.size();
+    if (seg->capacity < kAlign) return SegmentPtr();
+
+    seg->data = seg->file.map(0, seg->capacity);
+    if (!seg->data) return SegmentPtr();
+
+    SegmentHeader* header = reinterpret_cast<SegmentHeader*>(seg->data);
+    if (createCapacity > 0) {
+        header->magic = kSegmentMagic;
+        header->version = kSegmentVersion;
+    } else if (header->magic != kSegmentMagic || header->version != kSegmentVersion) {
+        return SegmentPtr();
+    }
+
+    seg->used = kAlign;
+    return seg;
+}
+
+void ThumbnailStore::open() {
+    m_segments.clear();
+    m_index.clear();
+    m_liveBytes = 0;
+    m_activeSegment = -1;
+
+    QDir dir(m_dir);
+    QStringList files = dir.entryList({"segment_*.pack"}, QDir::Files, QDir::Name);
+    for (const QString& name : files) {
+        int id = name.mid(8, 5).toInt();
+        SegmentPtr seg = openSegment(id, 0);
+        if (!seg) {
+            qWarning() << "Dropping unreadable thumbnail segment" << name;
+            dir.remove(name);
+            continue;
+        }
+
+        m_segments[id] = seg;
+        m_activeSegment = qMax(m_activeSegment, id);
+
+        // Rebuild the index from record headers. Only header pages are touched.
+        qint64 offset = kAlign;
+        while (offset + kAlign <= seg->capacity) {
+            const RecordHeader* hdr = reinterpret_cast<const RecordHeader*>(seg->data + offset);
+            if (hdr->magic != kRecordMagic || hdr->recordSize == 0 ||
+                offset + (qint64)hdr->recordSize > seg->capacity) {
+                break; // End of written data, or a torn append after a crash
+            }
+
+            if (hdr->flags & kRecordDead) {
+                seg->deadBytes += hdr->recordSize;
+            } else {
+                QString key = QString::fromUtf8(reinterpret_cast<const char*>(hdr + 1), hdr->keyLength);
+                auto existing = m_index.find(key);
+                if (existing != m_index.end()) {
+                    markDead(existing.value()); // Later write wins
+                    m_liveBytes -= existing->size;
+                }
+                Entry entry = {id, offset, (qint64)hdr->recordSize};
+                m_index[key] = entry;
+                m_liveBytes += entry.size;
+            }
+            offset += hdr->recordSize;
+        }
+        seg->used = offset;
+    }
+}
+
+void ThumbnailStore::clear() {
+    // Unlinking is enough: images still on screen keep their mapping alive
+    for (auto it = m_segments.begin(); it != m_segments.end(); ++it) {
+        QFile::remove(segmentPath(it.key()));
+    }
+    m_segments.clear();
+    m_index.clear();
+    m_liveBytes = 0;
+    m_activeSegment = -1;
+}
+
+bool ThumbnailStore::contains(const QString& key) const {
+    return m_index.contains(key);
+}
+
+QImage ThumbnailStore::image(const QString& key) const {
+    auto it = m_index.constFind(key);
+    if (it == m_index.constEnd()) return QImage();
+
+    SegmentPtr seg = m_segments.value(it->segment);
+    if (!seg) return QImage();
+
+    const uchar* record = seg->data + it->offset;
+    const RecordHeader* hdr = reinterpret_cast<const RecordHeader*>(record);
+    return QImage(record + hdr->dataOffset, hdr->width, hdr->height, hdr->bytesPerLine,
+                  QImage::Format(hdr->format), releaseSegment,
+                  new QSharedPointer<void>(seg));
+}
+
+qint64 ThumbnailStore::insert(const QString& key, const QImage& image) {
+    if (image.isNull()) return 0;
+
+    QImage img = image;
+    if (img.format() != QImage::Format_ARGB32_Premultiplied && img.format() != QImage::Format_RGB888) {
+        img = img.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+
+    remove(key);
+
+    Entry entry;
+    if (!append(key, img.constBits(), img.width(), img.height(), img.bytesPerLine(),
+                img.format(), &entry)) {
+        return 0;
+    }
+    m_index[key] = entry;
+    m_liveBytes += entry.size;
+    return entry.size;
+}
+
+void ThumbnailStore::remove(const QString& key) {
+    auto it = m_index.find(key);
+    if (it == m_index.end()) return;
+
+    markDead(it.value());
+    m_liveBytes -= it->size;
+    m_index.erase(it);
+}
+
+void ThumbnailStore::markDead(const Entry& entry) {
+    SegmentPtr seg = m_segments.value(entry.segment);
+    if (!seg) return;
+
+    // Flag in place; the pixels stay valid for anyone still showing them
+    RecordHeader* hdr = reinterpret_cast<RecordHeader*>(seg->data + entry.offset);
+    hdr->flags |= kRecordDead;
+    seg->deadBytes += entry.size;
+}
+
+ThumbnailStore::SegmentPtr ThumbnailStore::writableSegment(qint64 needed) {
+    SegmentPtr active = m_segments.value(m_activeSegment);
+    if (active && active->used + needed <= active->capacity) return active;
+
+    int id = m_activeSegment + 1;
+    SegmentPtr seg = openSegment(id, qMax(kSegmentCapacity, alignUp(needed + kAlign)));
+    if (!seg) {
+        qWarning() << "Could not create thumbnail segment" << segmentPath(id);
+        return SegmentPtr();
+    }
+    m_segments[id] = seg;
+    m_activeSegment = id;
+    return seg;
+}
+
+bool ThumbnailStore::append(const QString& key, const uchar* bits, int width, int height,
+                            int bytesPerLine, QImage::Format format, Entry* entry) {
+    QByteArray keyBytes = key.toUtf8();
+    qint64 dataOffset = alignUp(kAlign + keyBytes.size());
+    qint64 dataSize = (qint64)bytesPerLine * height;
+    qint64 recordSize = alignUp(dataOffset + dataSize);
+
+    SegmentPtr seg = writableSegment(recordSize);
+    if (!seg) return false;
+
+    uchar* record = seg->data + seg->used;
+    memcpy(record + kAlign, keyBytes.constData(), keyBytes.size());
+    memcpy(record + dataOffset, bits, dataSize);
+
+    RecordHeader* hdr = reinterpret_cast<RecordHeader*>(record);
+    hdr->flags = 0;
+    hdr->width = width;
+    hdr->height = height;
+    hdr->bytesPerLine = bytesPerLine;
+    hdr->format = format;
+    hdr->keyLength = keyBytes.size();
+    hdr->dataOffset = dataOffset;
+    hdr->recordSize = recordSize;
+
+    // The magic goes last and only once the rest is on disk, so a torn
+    // append is never indexed. It can be lost itself; that only drops the record.
+    if (!syncRange(seg->data, seg->used, recordSize)) {
+        qWarning() << "Could not sync thumbnail segment" << segmentPath(seg->id);
+        return false;
+    }
+    hdr->magic = kRecordMagic;
+
+    entry->segment = seg->id;
+    entry->offset = seg->used;
+    entry->size = recordSize;
+    seg->used += recordSize;
+    return true;
+}
+
+void ThumbnailStore::compact() {
+    QList<int> candidates;
+    for (auto it = m_segments.begin(); it != m_segments.end(); ++it) {
+        const SegmentPtr& seg = it.value();
+        qint64 payload = seg->used - kAlign;
+        if (it.key() != m_activeSegment && seg->deadBytes * 2 > payload) {
+            candidates << it.key();
+        }
+    }
+
+    for (int id : candidates) {
+        SegmentPtr seg = m_segments.value(id);
+
+        // Move survivors to the active segment
+        QMap<int, qint64> movedFrom; // Segment -> first offset written to it
+        for (auto it = m_index.begin(); it != m_index.end(); ++it) {
+            if (it->segment != id) continue;
+
+            const uchar* record = seg->data + it->offset;
+            const RecordHeader* hdr = reinterpret_cast<const RecordHeader*>(record);
+            Entry moved;
+            if (!append(it.key(), record + hdr->dataOffset, hdr->width, hdr->height,
+                        hdr->bytesPerLine, QImage::Format(hdr->format), &moved)) {
+                return; // Out of space; leave the rest for next time
+            }
+            if (!movedFrom.contains(moved.segment)) movedFrom[moved.segment] = moved.offset;
+            it.value() = moved;
+        }
+
+        // The copies' record magics must be on disk before the originals go
+        for (auto m = movedFrom.constBegin(); m != movedFrom.constEnd(); ++m) {
+            SegmentPtr target = m_segments.value(m.key());
+            if (!syncRange(target->data, m.value(), target->used - m.value())) {
+                qWarning() << "Could not sync thumbnail segment" << segmentPath(m.key());
+                return; // Keep the old segment; the index holds the copies for now
+            }
+        }
+
+        m_segments.remove(id);
+        QFile::remove(segmentPath(id));
+    }
+}
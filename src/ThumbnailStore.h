@@ -0,0 +1,69 @@
+#ifndef THUMBNAILSTORE_H
+#define THUMBNAILSTORE_H
+
+#include <QString>
+#include <QImage>
+#include <QHash>
+#include <QMap>
+#include <QFile>
+#include <QSharedPointer>
+
+// Packed thumbnail store.
+// Thumbnails are appended as raw pixels (RGB888 when opaque, else
+// ARGB32_Premultiplied) to a few large segment files which stay
+// memory-mapped, so reading one back is a pointer lookup wrapped in a
+// QImage - no open(), no decode, no copy.
+// Removal only flags the record; compact() rewrites segments that are mostly
+// dead. Owned by the loader thread, not thread-safe.
+class ThumbnailStore {
+public:
+    explicit ThumbnailStore(const QString& dir);
+    ~ThumbnailStore();
+
+    void open();
+    void clear();
+
+    bool contains(const QString& key) const;
+    QImage image(const QString& key) const; // zero-copy view, keeps its segment mapped
+    qint64 insert(const QString& key, const QImage& image); // bytes used, 0 on failure
+    void remove(const QString& key);
+
+    // Rewrites segments whose dead space exceeds half their used space
+    void compact();
+
+    qint64 liveBytes() const { return m_liveBytes; }
+    int count() const { return m_index.size(); }
+
+private:
+    struct Segment {
+        int id = -1;
+        QFile file;
+        uchar* data = nullptr;
+        qint64 capacity = 0;
+        qint64 used = 0;
+        qint64 deadBytes = 0;
+        ~Segment();
+    };
+    typedef QSharedPointer<Segment> SegmentPtr;
+
+    struct Entry {
+        int segment;
+        qint64 offset;
+        qint64 size;
+    };
+
+    SegmentPtr openSegment(int id, qint64 createCapacity); // 0 = open existing
+    SegmentPtr writableSegment(qint64 needed);
+    bool append(const QString& key, const uchar* bits, int width, int height,
+                int bytesPerLine, QImage::Format format, Entry* entry);
+    void markDead(const Entry& entry);
+    QString segmentPath(int id) const;
+
+    QString m_dir;
+    QMap<int, SegmentPtr> m_segments;
+    QHash<QString, Entry> m_index;
+    qint64 m_liveBytes;
+    int m_activeSegment;
+};
+
+#endif // THUMBNAILSTORE_H
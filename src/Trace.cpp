@@ -0,0 +1,264 @@
+#include "Trace.h"
+#include "SocketNotifier.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QSaveFile>
+#include <QThread>
+#include <QVector>
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+std::atomic<bool> Trace::s_enabled(false);
+
+namespace {
+const int kRingSize = 1 << 14; // Per thread; 40-byte events, 640 KiB each
+
+struct Event {
+    const char* name;
+    qint64 ts;
+    qint64 dur;
+    quint64 id;
+    char phase;
+};
+
+// Written only by its owner thread; head counts every event ever recorded.
+// The other fields are guarded by g_ringsMutex.
+struct ThreadRing {
+    int tid;
+    QString threadName;
+    quint64 start; // head when the current owner took the ring over
+    bool free;     // Owner has exited
+    std::atomic<quint64> head;
+    Event events[kRingSize];
+};
+
+// Rings outlive their threads so a dump still shows finished workers, until
+// a new thread takes the ring over. Pool threads expire and get replaced all
+// the time, so one ring per thread ever seen would grow without bound.
+QMutex g_ringsMutex;
+QVector<ThreadRing*> g_rings;
+int g_lastTid = 0;
+thread_local ThreadRing* t_ring = nullptr;
+
+// Frees the thread's ring on exit. Kept apart from t_ring so record() only
+// touches a plain pointer.
+struct RingOwner {
+    ThreadRing* ring = nullptr;
+    ~RingOwner() {
+        if (!ring) return;
+        QMutexLocker locker(&g_ringsMutex);
+        ring->free = true;
+        t_ring = nullptr;
+    }
+};
+thread_local RingOwner t_owner;
+
+QElapsedTimer& traceClock() {
+    static QElapsedTimer timer = [] { QElapsedTimer t; t.start(); return t; }();
+    return timer;
+}
+
+ThreadRing* currentRing() {
+    if (t_ring) return t_ring;
+
+    QThread* thread = QThread::currentThread();
+    QMutexLocker locker(&g_ringsMutex);
+    ThreadRing* ring = nullptr;
+    for (ThreadRing* candidate : g_rings) {
+        if (candidate->free) {
+            ring = candidate;
+            break;
+        }
+    }
+    if (ring) {
+        // What's in there belongs to the thread that left
+        ring->start = ring->head.load(std::memory_order_relaxed);
+    } else {
+        ring = new ThreadRing;
+        ring->start = 0;
+        ring->head.store(0, std::memory_order_relaxed);
+        g_rings.append(ring);
+    }
+    ring->free = false;
+    ring->tid = ++g_lastTid;
+    if (QCoreApplication::instance() && thread == QCoreApplication::instance()->thread()) {
+        ring->threadName = QStringLiteral("main");
+    } else if (thread && !thread->objectName().isEmpty()) {
+        ring->threadName = thread->objectName();
+    } else {
+        ring->threadName = QString("thread %1").arg(ring->tid);
+    }
+    t_ring = ring;
+    t_owner.ring = ring;
+    return ring;
+}
+
+QByteArray jsonString(const QString& s) {
+    QByteArray out = "\"";
+    for (QChar c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c.toLatin1();
+        } else if (c.unicode() < 0x20) {
+            out += QString::asprintf("\\u%04x", c.unicode()).toLatin1();
+        } else {
+            out += QString(c).toUtf8();
+        }
+    }
+    out += '"';
+    return out;
+}
+
+// Chrome wants microseconds; keep the sub-µs part
+QByteArray micros(qint64 ns) {
+    return QByteArray::number(ns / 1000) + '.' + QByteArray::number(ns % 1000).rightJustified(3, '0');
+}
+
+#ifdef Q_OS_UNIX
+// Self-pipe: the handler writes a byte, the event loop wakes on the read end
+int g_dumpPipe[2] = {-1, -1};
+
+void onDumpSignal(int) {
+    int saved = errno;
+    char byte = 1;
+    ssize_t written = write(g_dumpPipe[1], &byte, 1); // Full pipe: a dump is pending anyway
+    (void)written;
+    errno = saved;
+}
+#endif
+}
+
+void Trace::setEnabled(bool enabled) {
+    traceClock(); // Start the epoch before the first event
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+qint64 Trace::nowNs() {
+    return traceClock().nsecsElapsed();
+}
+
+void Trace::complete(const char* name, qint64 startNs, qint64 endNs) {
+    record('X', name, startNs, endNs - startNs, 0);
+}
+
+void Trace::instant(const char* name) {
+    record('i', name, nowNs(), 0, 0);
+}
+
+void Trace::asyncBegin(const char* name, quint64 id) {
+    record('b', name, nowNs(), 0, id);
+}
+
+void Trace::asyncEnd(const char* name, quint64 id) {
+    record('e', name, nowNs(), 0, id);
+}
+
+void Trace::record(char phase, const char* name, qint64 ts, qint64 dur, quint64 id) {
+    ThreadRing* ring = currentRing();
+    quint64 head = ring->head.load(std::memory_order_relaxed);
+    Event& e = ring->events[head % kRingSize];
+    e.name = name;
+    e.ts = ts;
+    e.dur = dur;
+    e.id = id;
+    e.phase = phase;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+bool Trace::writeJson(const QString& path) {
+    struct RingView {
+        ThreadRing* ring;
+        int tid;
+        QString threadName;
+        quint64 start;
+    };
+    QVector<RingView> rings;
+    {
+        QMutexLocker locker(&g_ringsMutex);
+        for (ThreadRing* ring : g_rings) rings.append({ring, ring->tid, ring->threadName, ring->start});
+    }
+
+    QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+    QByteArray out = "{\"traceEvents\":[\n";
+    bool first = true;
+    auto append = [&](const QByteArray& event) {
+        if (!first) out += ",\n";
+        out += event;
+        first = false;
+    };
+
+    for (const RingView& view : rings) {
+        QByteArray tid = QByteArray::number(view.tid);
+        append("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" + pid + ",\"tid\":" + tid +
+               ",\"args\":{\"name\":" + jsonString(view.threadName) + "}}");
+
+        quint64 head = view.ring->head.load(std::memory_order_acquire);
+        quint64 begin = qMax(view.start, head > quint64(kRingSize) ? head - kRingSize : 0);
+        for (quint64 i = begin; i < head; ++i) {
+            const Event& e = view.ring->events[i % kRingSize];
+            QByteArray event = "{\"ph\":\"" + QByteArray(1, e.phase) + "\",\"cat\":\"pipeline\",\"name\":" +
+                               jsonString(QString::fromLatin1(e.name)) + ",\"pid\":" + pid +
+                               ",\"tid\":" + tid + ",\"ts\":" + micros(e.ts);
+            if (e.phase == 'X') event += ",\"dur\":" + micros(e.dur);
+            if (e.phase == 'i') event += ",\"s\":\"t\"";
+            if (e.phase == 'b' || e.phase == 'e') event += ",\"id\":\"0x" + QByteArray::number(e.id, 16) + '"';
+            append(event + '}');
+        }
+    }
+    out += "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    file.write(out);
+    return file.commit();
+}
+
+void Trace::installDumpSignal(const QString& path) {
+#ifdef Q_OS_UNIX
+    if (pipe(g_dumpPipe) != 0) {
+        qWarning() << "Trace: can't create the SIGUSR1 pipe";
+        return;
+    }
+    for (int fd : g_dumpPipe) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+
+    struct sigaction action = {};
+    action.sa_handler = onDumpSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    if (sigaction(SIGUSR1, &action, nullptr) != 0) {
+        qWarning() << "Trace: can't install SIGUSR1 handler";
+        return;
+    }
+
+    // Handlers can't touch Qt; the event loop only wakes when a signal came
+    QSocketNotifier* notifier = new QSocketNotifier(g_dumpPipe[0], QSocketNotifier::Read,
+                                                    QCoreApplication::instance());
+    QObject::connect(notifier, SocketNotifier::activated(), [path]() {
+        char bytes[64];
+        bool requested = false;
+        while (read(g_dumpPipe[0], bytes, sizeof(bytes)) > 0) requested = true;
+        if (!requested) return;
+
+        if (!isEnabled()) {
+            setEnabled(true);
+            qInfo() << "Trace: recording; send SIGUSR1 again to write" << path;
+        } else if (writeJson(path)) {
+            qInfo() << "Trace: wrote" << path;
+        } else {
+            qWarning() << "Trace: can't write" << path;
+        }
+    });
+#else
+    Q_UNUSED(path);
+#endif
+}
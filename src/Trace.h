@@ -0,0 +1,68 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QString>
+#include <QtGlobal>
+#include <atomic>
+
+// Always-compiled tracing for the image pipeline. Spans and events go to a
+// lock-free ring per thread (the newest kRingSize per thread survive) and
+// can be written out as Chrome trace-event JSON, which chrome://tracing and
+// ui.perfetto.dev open directly. While disabled, each trace point costs one
+// relaxed atomic load.
+//
+// Names and categories must be string literals: only the pointer is kept.
+class Trace {
+public:
+    static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enabled);
+
+    static qint64 nowNs(); // Monotonic, shared by every thread
+
+    static void complete(const char* name, qint64 startNs, qint64 endNs);
+    static void instant(const char* name);
+    // Spans that start on one thread and end on another (e.g. a slide from
+    // request to delivery), matched by name and id
+    static void asyncBegin(const char* name, quint64 id);
+    static void asyncEnd(const char* name, quint64 id);
+
+    // Snapshot of every thread's ring; false if the file can't be written.
+    // Threads keep recording meanwhile, so their oldest entries may tear.
+    static bool writeJson(const QString& path);
+
+    // Unix: SIGUSR1 writes the trace to path, enabling tracing first if it
+    // was off (so the first signal starts recording, later ones dump).
+    // Needs a running event loop.
+    static void installDumpSignal(const QString& path);
+
+private:
+    static void record(char phase, const char* name, qint64 ts, qint64 dur, quint64 id);
+    static std::atomic<bool> s_enabled;
+};
+
+// Times the enclosing scope
+class TraceScope {
+public:
+    explicit TraceScope(const char* name) : m_name(Trace::isEnabled() ? name : nullptr) {
+        if (m_name) m_start = Trace::nowNs();
+    }
+    ~TraceScope() {
+        if (m_name) Trace::complete(m_name, m_start, Trace::nowNs());
+    }
+
+private:
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    const char* m_name;
+    qint64 m_start;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name)
+#define TRACE_INSTANT(name) do { if (Trace::isEnabled()) Trace::instant(name); } while (0)
+#define TRACE_ASYNC_BEGIN(name, id) do { if (Trace::isEnabled()) Trace::asyncBegin(name, id); } while (0)
+#define TRACE_ASYNC_END(name, id) do { if (Trace::isEnabled()) Trace::asyncEnd(name, id); } while (0)
+
+#endif // TRACE_H
@@ -1,15 +1,77 @@
 #include <QApplication>
 #include "MainWindow.h"
+#include "Trace.h"
+#include "MetricsServer.h"
+#include "ConfigManager.h"
+#include "CachePrewarmer.h"
+
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QDir>
+#include <QScopedPointer>
 
 #include <QStyleFactory>
 #include <QPalette>
+#include <cstdio>
 
 
 int main(int argc, char *argv[]) {
-    QApplication app(argc, argv);
+    // Pre-warming opens no window, so it mustn't need a display either. The
+    // application type has to be picked before Qt sees the arguments.
+    bool headless = false;
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--prewarm") == 0 || qstrncmp(argv[i], "--prewarm=", 10) == 0) headless = true;
+    }
+    if (headless && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) qputenv("QT_QPA_PLATFORM", "offscreen");
+    QScopedPointer<QGuiApplication> app(headless ? new QGuiApplication(argc, argv) : new QApplication(argc, argv));
+
+    QCoreApplication::setOrganizationName("Antigravity");
+    QCoreApplication::setApplicationName("SmoothSlideshow");
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption traceOption("trace",
+        "Record a pipeline trace from startup and write it to <file> (Chrome trace JSON) on exit.",
+        "file");
+    QCommandLineOption prewarmOption("prewarm",
+        "Generate every missing thumbnail for <folder> without opening a window, then exit.",
+        "folder");
+    QCommandLineOption recursiveOption("recursive", "With --prewarm: include subfolders.");
+    QCommandLineOption jobsOption("jobs", "With --prewarm: generator threads (default: one per core).", "N");
+    parser.addOptions({traceOption, prewarmOption, recursiveOption, jobsOption});
+    parser.process(*app);
+
+    // SIGUSR1 toggles/dumps the trace either way
+    QString tracePath = parser.value(traceOption);
+    if (!tracePath.isEmpty()) {
+        Trace::setEnabled(true);
+        QObject::connect(app.data(), &QCoreApplication::aboutToQuit, [tracePath]() {
+            if (!Trace::writeJson(tracePath)) qWarning() << "Trace: can't write" << tracePath;
+        });
+    } else {
+        tracePath = QDir::temp().filePath(QString("smoothslideshow-trace-%1.json")
+                                              .arg(QCoreApplication::applicationPid()));
+    }
+    Trace::installDumpSignal(tracePath);
+
+    if (parser.isSet(prewarmOption)) {
+        bool ok = true;
+        int jobs = parser.isSet(jobsOption) ? parser.value(jobsOption).toInt(&ok) : 0;
+        if (!ok || jobs < 0) {
+            fprintf(stderr, "--jobs wants a thread count\n");
+            return CachePrewarmer::Failed;
+        }
+        ConfigManager::instance().load(); // For cache_max_size_mb
+
+        // Exit code for scripts: 0 done, 1 failed, 3 stopped at the cache limit
+        CachePrewarmer prewarmer;
+        QObject::connect(&prewarmer, &CachePrewarmer::finished, app.data(), &QCoreApplication::exit);
+        prewarmer.start(parser.value(prewarmOption), parser.isSet(recursiveOption), jobs);
+        return app->exec();
+    }
     
     // Set Dark Theme (Fusion)
-    app.setStyle(QStyleFactory::create("Fusion"));
+    QApplication::setStyle(QStyleFactory::create("Fusion"));
     
     QPalette darkPalette;
     darkPalette.setColor(QPalette::Window, QColor(53, 53, 53));
@@ -26,16 +88,19 @@ int main(int argc, char *argv[]) {
     darkPalette.setColor(QPalette::Highlight, QColor(42, 130, 218));
     darkPalette.setColor(QPalette::HighlightedText, Qt::black);
     
-    app.setPalette(darkPalette);
+    QApplication::setPalette(darkPalette);
     
-    app.setStyleSheet("QToolTip { color: #ffffff; background-color: #2a82da; border: 1px solid white; }");
-
-    QCoreApplication::setOrganizationName("Antigravity");
-    QCoreApplication::setApplicationName("SmoothSlideshow");
+    qApp->setStyleSheet("QToolTip { color: #ffffff; background-color: #2a82da; border: 1px solid white; }");
     
     MainWindow w;
+
+    // For unattended kiosks: a local scraper watches decode times, late
+    // fades and cache churn instead of someone watching the screen
+    MetricsServer metrics;
+    int metricsPort = ConfigManager::instance().metricsPort();
+    if (metricsPort > 0) metrics.listen(metricsPort);
     w.resize(1024, 768);
     w.show();
     
-    return app.exec();
+    return app->exec();
 }